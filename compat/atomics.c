@@ -0,0 +1,31 @@
+#include "atomics.h"
+
+int
+atomics_load(atomic_t *a)
+{
+#ifdef _MSC_VER
+	return InterlockedCompareExchange(a, 0, 0);
+#else
+	return __atomic_load_n(a, __ATOMIC_ACQUIRE);
+#endif
+}
+
+void
+atomics_store(atomic_t *a, int value)
+{
+#ifdef _MSC_VER
+	InterlockedExchange(a, value);
+#else
+	__atomic_store_n(a, value, __ATOMIC_RELEASE);
+#endif
+}
+
+int
+atomics_exchange(atomic_t *a, int value)
+{
+#ifdef _MSC_VER
+	return InterlockedExchange(a, value);
+#else
+	return __atomic_exchange_n(a, value, __ATOMIC_ACQ_REL);
+#endif
+}
@@ -0,0 +1,19 @@
+/**
+ * Platform-agnostic atomic int operations. Loads have acquire semantics,
+ * stores have release semantics, and exchanges have both
+ */
+#ifndef atomics_h
+#define atomics_h
+
+#ifdef _MSC_VER
+#include <windows.h>
+typedef volatile LONG atomic_t;
+#else
+typedef volatile int atomic_t;
+#endif
+
+int  atomics_load(atomic_t *a);
+void atomics_store(atomic_t *a, int value);
+int  atomics_exchange(atomic_t *a, int value);
+
+#endif
@@ -1,17 +1,15 @@
 #include "threads.h"
 
 
-thread_t
-thread_create(thread_ret_t (*function)(void*), void *args)
+int
+thread_create(thread_t *tid, thread_ret_t (*function)(void*), void *args)
 {
-	thread_t retval;
 #ifdef _MSC_VER
-	retval = CreateThread(NULL, 0, function, args, 0, NULL);
+	*tid = CreateThread(NULL, 0, function, args, 0, NULL);
+	return *tid == NULL;
 #else
-	pthread_create(&retval, NULL, function, args);
+	return pthread_create(tid, NULL, function, args) != 0;
 #endif
-
-	return retval;
 }
 
 thread_ret_t
@@ -14,7 +14,8 @@ typedef pthread_t thread_t;
 typedef void* thread_ret_t;
 #endif
 
-thread_t thread_create(thread_ret_t (*function)(void*), void *args);
+/* Returns 0 on success, non-zero if the thread could not be started */
+int thread_create(thread_t *tid, thread_ret_t (*function)(void*), void *args);
 thread_ret_t thread_join(thread_t tid);
 
 #endif
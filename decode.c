@@ -7,343 +7,836 @@
 #include <include/rs41.h>
 #include <math.h>
 #include <string.h>
+#include "compat/atomics.h"
+#include "compat/semaphore.h"
+#include "compat/threads.h"
 #include "decode.h"
+#include "demod/classifier.h"
 #include "log/log.h"
 #include "physics.h"
+#include "sonde/c50/protocol.h"
+#include "sonde/dfm09/protocol.h"
+#include "sonde/imet4/protocol.h"
+#include "sonde/ims100/protocol.h"
+#include "sonde/m10/protocol.h"
+#include "sonde/mrz-n1/protocol.h"
+#include "sonde/rs41/protocol.h"
+#include "track.h"
 #include "utils.h"
 
-#define CHUNKSIZE 1024
+typedef ParserStatus (*decoder_fn_t)(void*, SondeData*, const float*, size_t);
+
+/* Re-enable all decoders every this many classifier decisions */
+#define AUTODETECT_RESET_INTERVAL 40
+
+/* Keep running a decoder in AUTO mode for this long after its last frame, s */
+#define AUTODETECT_LOCK_TIMEOUT 60
+
+/* Max frames a parallel worker can queue before it has to wait for them to be
+ * consumed */
+#define AUTODETECT_QUEUE_LEN 8
+
+/* Max number of sondes tracked at once, must be a power of 2 */
+#define SONDE_MAP_SIZE 16
+
+/* Set in the middle snapshot index when it holds unread data */
+#define SNAPSHOT_DIRTY 0x4
+
+typedef void* (*decoder_init_fn_t)(int samplerate);
+typedef void (*decoder_deinit_fn_t)(void *instance);
+
+/* Decoders compiled in, in order of precedence for AUTO mode, along with the
+ * line parameters the pre-classifier uses to rule them out */
+static const struct {
+	enum decoder type;
+	const char *name;
+	decoder_init_fn_t init;
+	decoder_deinit_fn_t deinit;
+	decoder_fn_t decode;
+	int baudrate;
+	int manchester;
+	float f_mark, f_space;      /* AFSK only */
+} _decoders[] = {
+#ifdef ENABLE_RS41
+	{ RS41,   "RS41",    (decoder_init_fn_t)&rs41_decoder_init,   (decoder_deinit_fn_t)&rs41_decoder_deinit,
+	          (decoder_iface_t)&rs41_decode,   RS41_BAUDRATE,   0, 0, 0 },
+#endif
+#ifdef ENABLE_M10
+	{ M10,    "M10",     (decoder_init_fn_t)&m10_decoder_init,    (decoder_deinit_fn_t)&m10_decoder_deinit,
+	          (decoder_iface_t)&m10_decode,    M10_BAUDRATE,    1, 0, 0 },
+#endif
+#ifdef ENABLE_IMS100
+	{ IMS100, "iMS100",  (decoder_init_fn_t)&ims100_decoder_init, (decoder_deinit_fn_t)&ims100_decoder_deinit,
+	          (decoder_iface_t)&ims100_decode, IMS100_BAUDRATE, 1, 0, 0 },
+#endif
+#ifdef ENABLE_DFM09
+	{ DFM09,  "DFM09",   (decoder_init_fn_t)&dfm09_decoder_init,  (decoder_deinit_fn_t)&dfm09_decoder_deinit,
+	          (decoder_iface_t)&dfm09_decode,  DFM09_BAUDRATE,  1, 0, 0 },
+#endif
+#ifdef ENABLE_IMET4
+	{ IMET4,  "iMet-4",  (decoder_init_fn_t)&imet4_decoder_init,  (decoder_deinit_fn_t)&imet4_decoder_deinit,
+	          (decoder_iface_t)&imet4_decode,  IMET4_BAUDRATE,  0, IMET4_MARK_FREQ, IMET4_SPACE_FREQ },
+#endif
+#ifdef ENABLE_C50
+	{ C50,    "SRS C50", (decoder_init_fn_t)&c50_decoder_init,    (decoder_deinit_fn_t)&c50_decoder_deinit,
+	          (decoder_iface_t)&c50_decode,    C50_BAUDRATE,    0, C50_MARK_FREQ, C50_SPACE_FREQ },
+#endif
+#ifdef ENABLE_MRZN1
+	{ MRZN1,  "MRZ-N1",  (decoder_init_fn_t)&mrzn1_decoder_init,  (decoder_deinit_fn_t)&mrzn1_decoder_deinit,
+	          (decoder_iface_t)&mrzn1_decode,  MRZN1_BAUDRATE,  1, 0, 0 },
+#endif
+};
+
+/* Persistent worker running one of the AUTO mode decoders */
+typedef struct {
+	SondeDecoderCtx *ctx;
+	thread_t tid;
+	semaphore_t start;
+	decoder_fn_t decode;
+	void *instance;
+	SondeData queue[AUTODETECT_QUEUE_LEN];
+	int queue_count, queue_read;
+	int queue_full;             /* Stopped before the end of the buffer */
+} AutodetectWorker;
+
+/* Per-sonde state, keyed on decoder type + serial number. Frames decoded
+ * before the serial number is known go to a placeholder with an empty serial */
+typedef struct {
+	int used;
+	enum decoder type;
+	char serial[sizeof(((SondeData*)0)->serial)];
+	uint64_t last_update;
+
+	SondeData printable;
+	Track track;
+} SondeState;
+
+struct sondedecoderctx {
+	decoder_fn_t active_decoder_decode;
+	void *active_decoder_ctx;
+	/* Only written by the thread calling decode(). Other threads request a
+	 * switch through requested_decoder (-1 = no request pending), which is
+	 * consumed at the start of the next decode() call */
+	atomic_t active_decoder;
+	atomic_t requested_decoder;
+
+	/* Decoder instances, created on first use and released once they've
+	 * gone idle_timeout samples (0 = never) without producing any data */
+	void *instances[END];
+	uint64_t last_used[END];
+	uint64_t idle_timeout;
+
+	/* Parallel autodetection: workers are started together on each buffer,
+	 * and each posts pool_done once it's done with it */
+	AutodetectWorker *pool;
+	semaphore_t pool_done;
+	const float *pool_buf;
+	size_t pool_len;
+	int pool_quit;
+
+	/* Pre-classifier, ruling out decoders that cannot match the signal */
+	Classifier classifier;
+	uint32_t candidates, all_candidates;
+	int classifier_decisions;
+
+	/* Decoders that produced data recently, and when they last did so */
+	uint32_t locked;
+	uint64_t lock_time[END];
+	uint32_t running;
+	int auto_idx;
+
+	/* Per-sonde state */
+	SondeState sondes[SONDE_MAP_SIZE];
+	SondeState *current[END];   /* Sonde each decoder is currently receiving */
+	SondeState *latest;         /* Most recently updated sonde */
+	atomic_t update_count;
+
+	/* Triple buffer publishing the latest data to a reader thread: the
+	 * decoder fills snapshots[snap_back], then swaps it with the middle
+	 * buffer, flagging it as dirty. The reader swaps the middle buffer with
+	 * snapshots[snap_front] whenever the dirty flag is set */
+	DecoderSnapshot snapshots[3];
+	int snap_back, snap_front;
+	atomic_t snap_middle;
+	int snap_generation;
+
+	int samplerate;
+	uint64_t sample_time;
+	uint64_t id_offset;
+};
+
+static void get_decoder(SondeDecoderCtx *ctx, enum decoder type, decoder_fn_t *decode, void **instance);
+static void* get_instance(SondeDecoderCtx *ctx, int idx);
+static void release_idle(SondeDecoderCtx *ctx);
+static void pool_stop(SondeDecoderCtx *ctx, int count);
+static void autodetect_parallel(SondeDecoderCtx *ctx, const float *srcbuf, size_t len);
+static thread_ret_t autodetect_worker(void *args);
+static ParserStatus decode_auto(SondeDecoderCtx *ctx, const float *srcbuf, size_t len);
+static void data_received(SondeDecoderCtx *ctx, enum decoder type, SondeData *data);
+static SondeState* route_data(SondeDecoderCtx *ctx, enum decoder type, const SondeData *data);
+static SondeState* sonde_lookup(SondeDecoderCtx *ctx, enum decoder type, const char *serial);
+static void append_data_point(SondeDecoderCtx *ctx, SondeState *sonde, SondeData *data);
+static void switch_decoder(SondeDecoderCtx *ctx, enum decoder decoder);
+static void publish_snapshot(SondeDecoderCtx *ctx);
+
+/* Context backing the single-stream API */
+static SondeDecoderCtx *_default_ctx;
 
-static void append_data_point(SondeData *data);
-
-static ParserStatus (*active_decoder_decode)(void*, SondeData*, const float*, size_t);
-static void *active_decoder_ctx;
-static enum decoder active_decoder;
-static int decoder_changed;
-
-static RS41Decoder *rs41decoder = NULL;
-static DFM09Decoder *dfm09decoder = NULL;
-static IMS100Decoder *ims100decoder = NULL;
-static M10Decoder *m10decoder = NULL;
-static MRZN1Decoder *mrzn1decoder = NULL;
-static IMET4Decoder *imet4decoder = NULL;
-static C50Decoder *c50decoder = NULL;
-
-static SondeData printable;
-static int has_data, new_data;
+int
+decoder_is_available(enum decoder type)
+{
+	int i;
 
-static GeoPoint *track;
-static int reserved_count;
-static int sample_count;
-static int new_samplerate = -1;
-static uint64_t id_offset;
+	if (type == AUTO) return 1;
+	for (i=0; i<(int)LEN(_decoders); i++) {
+		if (_decoders[i].type == type) return 1;
+	}
+	return 0;
+}
 
-int
-decoder_init(int samplerate)
+SondeDecoderCtx*
+decoder_ctx_init(int samplerate)
 {
-	if (samplerate <= 0) return 1;
+	SondeDecoderCtx *ctx;
+	int i;
 
-	/* Initialize decoders */
-	rs41decoder = rs41_decoder_init(samplerate);
-	dfm09decoder = dfm09_decoder_init(samplerate);
-	ims100decoder = ims100_decoder_init(samplerate);
-	m10decoder = m10_decoder_init(samplerate);
-	imet4decoder = imet4_decoder_init(samplerate);
-	c50decoder = c50_decoder_init(samplerate);
-	mrzn1decoder = mrzn1_decoder_init(samplerate);
+	if (samplerate <= 0) return NULL;
+	if (!(ctx = malloc(sizeof(*ctx)))) return NULL;
+
+	/* Decoders are created on first use */
+	memset(ctx->instances, 0, sizeof(ctx->instances));
+	memset(ctx->last_used, 0, sizeof(ctx->last_used));
+	ctx->idle_timeout = 0;
 
 	/* Initialize pointers to "no decoder" */
-	active_decoder_decode = NULL;
-	active_decoder_ctx = NULL;
-	active_decoder = AUTO;
+	ctx->active_decoder_decode = NULL;
+	ctx->active_decoder_ctx = NULL;
+	ctx->active_decoder = AUTO;
+	ctx->requested_decoder = -1;
+	ctx->pool = NULL;
+
+	/* Initialize pre-classifier */
+	classifier_init(&ctx->classifier, samplerate);
+	ctx->all_candidates = 0;
+	for (i=0; i<(int)LEN(_decoders); i++) {
+		if (_decoders[i].f_mark > 0) {
+			classifier_add_afsk(&ctx->classifier, 1 << _decoders[i].type, samplerate,
+			                    _decoders[i].f_mark, _decoders[i].f_space);
+		} else {
+			classifier_add_gfsk(&ctx->classifier, 1 << _decoders[i].type, samplerate,
+			                    _decoders[i].baudrate, _decoders[i].manchester);
+		}
+		ctx->all_candidates |= 1 << _decoders[i].type;
+	}
+	ctx->candidates = ctx->all_candidates;
+	ctx->classifier_decisions = 0;
+	ctx->locked = 0;
+	ctx->running = ctx->candidates;
+	ctx->auto_idx = -1;
+
+	/* Initialize per-sonde state */
+	memset(ctx->sondes, 0, sizeof(ctx->sondes));
+	for (i=0; i<SONDE_MAP_SIZE; i++) {
+		track_init(&ctx->sondes[i].track);
+	}
+	memset(ctx->current, 0, sizeof(ctx->current));
+	ctx->latest = NULL;
+	ctx->update_count = 0;
 
-	/* Initialize historical data pointers */
-	track = malloc(CHUNKSIZE * sizeof(*track));
-	reserved_count = CHUNKSIZE;
-	sample_count = 0;
+	memset(ctx->snapshots, 0, sizeof(ctx->snapshots));
+	ctx->snap_back = 0;
+	ctx->snap_middle = 1;
+	ctx->snap_front = 2;
+	ctx->snap_generation = 0;
 
-	id_offset = time(NULL);
+	ctx->samplerate = samplerate;
+	ctx->sample_time = 0;
 
-	/* Initialize data double-buffer */
-	memset(&printable, 0, sizeof(printable));
-	has_data = 0;
-	new_data = 0;
+	ctx->id_offset = time(NULL);
 
-	decoder_changed = 1;
+	publish_snapshot(ctx);
 
-	return 0;
+	return ctx;
 }
 
-
 void
-decoder_deinit(void)
+decoder_ctx_deinit(SondeDecoderCtx *ctx)
 {
+	int i;
+
+	if (!ctx) return;
+
+	decoder_ctx_set_parallel(ctx, 0);
+
 	/* Deinitialize all decoders */
-	if (rs41decoder) {
-		rs41_decoder_deinit(rs41decoder);
-		rs41decoder = NULL;
+	for (i=0; i<(int)LEN(_decoders); i++) {
+		if (ctx->instances[_decoders[i].type]) _decoders[i].deinit(ctx->instances[_decoders[i].type]);
 	}
-	if (ims100decoder) {
-		ims100_decoder_deinit(ims100decoder);
-		ims100decoder = NULL;
-	}
-	if (m10decoder) {
-		m10_decoder_deinit(m10decoder);
-		m10decoder = NULL;
+
+	/* Clear history buffers */
+	for (i=0; i<SONDE_MAP_SIZE; i++) {
+		track_deinit(&ctx->sondes[i].track);
 	}
-	if (dfm09decoder) {
-		dfm09_decoder_deinit(dfm09decoder);
-		dfm09decoder = NULL;
+	free(ctx);
+}
+
+ParserStatus
+decoder_ctx_decode(SondeDecoderCtx *ctx, const float *srcbuf, size_t len)
+{
+	SondeData data;
+	int requested;
+
+	/* Handle decoder switch */
+	requested = atomics_exchange(&ctx->requested_decoder, -1);
+	if (requested >= 0 && requested != ctx->active_decoder) {
+		switch_decoder(ctx, requested);
 	}
-	if (imet4decoder) {
-		imet4_decoder_deinit(imet4decoder);
-		imet4decoder = NULL;
+
+	/* Parse based on decoder */
+	switch (ctx->active_decoder) {
+	case AUTO:
+		return decode_auto(ctx, srcbuf, len);
+	default:
+		if (!ctx->active_decoder_ctx) break;
+		while (ctx->active_decoder_decode(ctx->active_decoder_ctx, &data, srcbuf, len) != PROCEED) {
+			data_received(ctx, ctx->active_decoder, &data);
+			return PARSED;
+		}
+
+		/* Buffer consumed */
+		ctx->sample_time += len;
+		release_idle(ctx);
+		break;
 	}
-	if (c50decoder) {
-		c50_decoder_deinit(c50decoder);
-		c50decoder = NULL;
+	return PROCEED;
+}
+
+enum decoder
+decoder_ctx_get_active(const SondeDecoderCtx *ctx)
+{
+	SondeDecoderCtx *mut_ctx = (SondeDecoderCtx*)ctx;
+	int requested;
+
+	/* Report a pending switch as already done, so that consecutive switches
+	 * requested before the decoder gets to them add up */
+	requested = atomics_load(&mut_ctx->requested_decoder);
+	return requested >= 0 ? requested : atomics_load(&mut_ctx->active_decoder);
+}
+
+void
+decoder_ctx_set_active(SondeDecoderCtx *ctx, enum decoder decoder)
+{
+	decoder = (decoder + END) % END;
+	if (!decoder_is_available(decoder)) return;
+
+	atomics_store(&ctx->requested_decoder, decoder);
+}
+
+void
+decoder_ctx_set_idle_timeout(SondeDecoderCtx *ctx, int seconds)
+{
+	ctx->idle_timeout = seconds > 0 ? (uint64_t)seconds * ctx->samplerate : 0;
+}
+
+int
+decoder_ctx_set_parallel(SondeDecoderCtx *ctx, int enable)
+{
+	AutodetectWorker *worker;
+	int i;
+
+	if (!enable == !ctx->pool) return 0;
+
+	if (!enable) {
+		pool_stop(ctx, LEN(_decoders));
+		return 0;
 	}
-	if (mrzn1decoder) {
-		mrzn1_decoder_deinit(mrzn1decoder);
-		mrzn1decoder = NULL;
+
+	if (!(ctx->pool = malloc(LEN(_decoders) * sizeof(*ctx->pool)))) return 1;
+	ctx->pool_quit = 0;
+	semaphore_init(&ctx->pool_done, 0);
+
+	/* One worker per decoder, so that each decoder's state stays on the same
+	 * thread across buffers */
+	for (i=0; i<(int)LEN(_decoders); i++) {
+		worker = &ctx->pool[i];
+		worker->ctx = ctx;
+		worker->queue_count = worker->queue_read = 0;
+		worker->queue_full = 0;
+		worker->decode = _decoders[i].decode;
+		worker->instance = NULL;
+		semaphore_init(&worker->start, 0);
+		if (thread_create(&worker->tid, autodetect_worker, worker)) {
+			semaphore_destroy(&worker->start);
+			pool_stop(ctx, i);
+			return 1;
+		}
 	}
 
-	/* Clear history buffers */
-	sample_count = 0;
-	if (track) {
-		free(track);
-		track = NULL;
+	return 0;
+}
+
+const SondeData*
+decoder_ctx_get_data(const SondeDecoderCtx *ctx)
+{
+	static const SondeData empty;
+	return ctx->latest ? &ctx->latest->printable : &empty;
+}
+
+int
+decoder_ctx_get_update_count(const SondeDecoderCtx *ctx)
+{
+	return atomics_load((atomic_t*)&ctx->update_count);
+}
+
+const DecoderSnapshot*
+decoder_ctx_get_snapshot(SondeDecoderCtx *ctx)
+{
+	if (atomics_load(&ctx->snap_middle) & SNAPSHOT_DIRTY) {
+		ctx->snap_front = atomics_exchange(&ctx->snap_middle, ctx->snap_front) & ~SNAPSHOT_DIRTY;
 	}
+	return &ctx->snapshots[ctx->snap_front];
+}
+
+/* Single-stream API {{{ */
+int
+decoder_init(int samplerate)
+{
+	decoder_ctx_deinit(_default_ctx);
+	_default_ctx = decoder_ctx_init(samplerate);
+	return _default_ctx == NULL;
+}
+
+void
+decoder_deinit(void)
+{
+	decoder_ctx_deinit(_default_ctx);
+	_default_ctx = NULL;
 }
 
 void
-decoder_set_samplerate(int samplerate)
+decoder_set_idle_timeout(int seconds)
 {
-	new_samplerate = samplerate;
+	decoder_ctx_set_idle_timeout(_default_ctx, seconds);
+}
+
+int
+decoder_set_parallel(int enable)
+{
+	return decoder_ctx_set_parallel(_default_ctx, enable);
 }
 
 ParserStatus
 decode(const float *srcbuf, size_t len)
 {
-	SondeData data;
+	return decoder_ctx_decode(_default_ctx, srcbuf, len);
+}
 
-	if (decoder_changed) {
-		/* Handle decoder switch */
-		switch (active_decoder) {
-		case RS41:
-			active_decoder_decode = (decoder_iface_t)&rs41_decode;
-			active_decoder_ctx = rs41decoder;
-			break;
-		case DFM09:
-			active_decoder_decode = (decoder_iface_t)&dfm09_decode;
-			active_decoder_ctx = dfm09decoder;
-			break;
-		case M10:
-			active_decoder_decode = (decoder_iface_t)&m10_decode;
-			active_decoder_ctx = m10decoder;
-			break;
-		case IMS100:
-			active_decoder_decode = (decoder_iface_t)&ims100_decode;
-			active_decoder_ctx = ims100decoder;
-			break;
-		case IMET4:
-			active_decoder_decode = (decoder_iface_t)&imet4_decode;
-			active_decoder_ctx = imet4decoder;
-			break;
-		case C50:
-			active_decoder_decode = (decoder_iface_t)&c50_decode;
-			active_decoder_ctx = c50decoder;
-			break;
-		case MRZN1:
-			active_decoder_decode = (decoder_iface_t)&mrzn1_decode;
-			active_decoder_ctx = mrzn1decoder;
-			break;
-		default:
-			break;
+enum decoder
+get_active_decoder(void)
+{
+	return decoder_ctx_get_active(_default_ctx);
+}
+
+void
+set_active_decoder(enum decoder decoder)
+{
+	decoder_ctx_set_active(_default_ctx, decoder);
+}
+
+const SondeData*
+get_data(void)
+{
+	return decoder_ctx_get_data(_default_ctx);
+}
+
+const DecoderSnapshot*
+get_snapshot(void)
+{
+	return decoder_ctx_get_snapshot(_default_ctx);
+}
+
+int
+get_slot(void) {
+	return decoder_ctx_get_update_count(_default_ctx);
+}
+/* }}} */
+
+/* Static functions {{{ */
+static void
+get_decoder(SondeDecoderCtx *ctx, enum decoder type, decoder_fn_t *decode, void **instance)
+{
+	int i;
+
+	for (i=0; i<(int)LEN(_decoders); i++) {
+		if (_decoders[i].type == type) {
+			*decode = _decoders[i].decode;
+			*instance = get_instance(ctx, i);
+			return;
 		}
+	}
+}
 
-		decoder_changed = 0;
+static void*
+get_instance(SondeDecoderCtx *ctx, int idx)
+{
+	const enum decoder type = _decoders[idx].type;
+
+	if (!ctx->instances[type]) {
+		log_debug("Creating %s decoder", _decoders[idx].name);
+		ctx->instances[type] = _decoders[idx].init(ctx->samplerate);
+		ctx->last_used[type] = ctx->sample_time;
 	}
 
-	/* Parse based on decoder */
-	switch (active_decoder) {
-	case END:
-		/* Decoder is being changed: wait */
-		return PARSED;
-		break;
-	case AUTO:
-		while (rs41_decode(rs41decoder, &data, srcbuf, len) != PROCEED) {
-			if (data.fields) {
-				log_info("Autodetected: RS41");
-				set_active_decoder(RS41);
+	return ctx->instances[type];
+}
+
+static void
+release_idle(SondeDecoderCtx *ctx)
+{
+	enum decoder type;
+	int i;
+
+	if (!ctx->idle_timeout) return;
+
+	for (i=0; i<(int)LEN(_decoders); i++) {
+		type = _decoders[i].type;
+
+		if (!ctx->instances[type] || (int)type == ctx->active_decoder) continue;
+		if (ctx->active_decoder == AUTO && ctx->running & (1 << type)) continue;
+		if (ctx->sample_time - ctx->last_used[type] < ctx->idle_timeout) continue;
+
+		log_debug("Releasing idle %s decoder", _decoders[i].name);
+		_decoders[i].deinit(ctx->instances[type]);
+		ctx->instances[type] = NULL;
+	}
+}
+
+/**
+ * Stop the first count workers of the pool and free it
+ */
+static void
+pool_stop(SondeDecoderCtx *ctx, int count)
+{
+	int i;
+
+	/* Wake up the workers and wait for them to exit */
+	ctx->pool_quit = 1;
+	for (i=0; i<count; i++) {
+		semaphore_post(&ctx->pool[i].start);
+	}
+	for (i=0; i<count; i++) {
+		thread_join(ctx->pool[i].tid);
+		semaphore_destroy(&ctx->pool[i].start);
+	}
+	semaphore_destroy(&ctx->pool_done);
+	free(ctx->pool);
+	ctx->pool = NULL;
+}
+
+static void
+autodetect_parallel(SondeDecoderCtx *ctx, const float *srcbuf, size_t len)
+{
+	int i, started;
+
+	/* Fan the buffer out to the workers running candidate decoders, then wait
+	 * for all of them to be done with it before returning it to the caller */
+	ctx->pool_buf = srcbuf;
+	ctx->pool_len = len;
+	started = 0;
+	for (i=0; i<(int)LEN(_decoders); i++) {
+		ctx->pool[i].queue_count = ctx->pool[i].queue_read = 0;
+		ctx->pool[i].queue_full = 0;
+		if (!(ctx->running & (1 << _decoders[i].type))) continue;
+
+		/* Instances are created here rather than by the workers, so that
+		 * they're only ever created/released by the thread calling decode() */
+		if (!(ctx->pool[i].instance = get_instance(ctx, i))) continue;
+		semaphore_post(&ctx->pool[i].start);
+		started++;
+	}
+	for (i=0; i<started; i++) {
+		semaphore_wait(&ctx->pool_done);
+	}
+}
+
+static thread_ret_t
+autodetect_worker(void *args)
+{
+	AutodetectWorker *worker = args;
+	SondeDecoderCtx *ctx = worker->ctx;
+	SondeData data;
+
+	for (;;) {
+		semaphore_wait(&worker->start);
+		if (ctx->pool_quit) break;
+
+		worker->queue_full = 0;
+		while (worker->decode(worker->instance, &data, ctx->pool_buf, ctx->pool_len) != PROCEED) {
+			if (!data.fields) continue;
+
+			/* If the queue fills up, stop here: decode_auto() restarts the
+			 * worker on the same buffer once it has consumed the queue */
+			worker->queue[worker->queue_count++] = data;
+			if (worker->queue_count == AUTODETECT_QUEUE_LEN) {
+				worker->queue_full = 1;
 				break;
 			}
 		}
-		while (m10_decode(m10decoder, &data, srcbuf, len) != PROCEED) {
-			if (data.fields) {
-				log_info("Autodetected: M10");
-				set_active_decoder(M10);
-				break;
-			}
+
+		semaphore_post(&ctx->pool_done);
+	}
+
+	return 0;
+}
+
+static ParserStatus
+decode_auto(SondeDecoderCtx *ctx, const float *srcbuf, size_t len)
+{
+	const uint64_t lock_timeout = (uint64_t)AUTODETECT_LOCK_TIMEOUT * ctx->samplerate;
+	AutodetectWorker *worker;
+	SondeData data;
+	void *instance;
+	int i;
+
+	/* New buffer: decide which decoders to run on it */
+	if (ctx->auto_idx < 0) {
+		ctx->sample_time += len;
+
+		/* Narrow down the set of decoders to try. Every once in a while, try
+		 * all of them regardless of what the classifier says */
+		if (classifier_feed(&ctx->classifier, srcbuf, len)) {
+			ctx->classifier_decisions = (ctx->classifier_decisions + 1) % AUTODETECT_RESET_INTERVAL;
+			ctx->candidates = ctx->classifier_decisions
+			                ? classifier_match(&ctx->classifier)
+			                : ctx->all_candidates;
 		}
-		while (ims100_decode(ims100decoder, &data, srcbuf, len) != PROCEED) {
-			if (data.fields) {
-				log_info("Autodetected: iMS100");
-				set_active_decoder(IMS100);
-				break;
+
+		/* Decoders that produced data recently keep running regardless */
+		for (i=0; i<(int)LEN(_decoders); i++) {
+			if (ctx->locked & (1 << _decoders[i].type)
+			 && ctx->sample_time - ctx->lock_time[_decoders[i].type] > lock_timeout) {
+				log_info("Lost: %s", _decoders[i].name);
+				ctx->locked &= ~(1 << _decoders[i].type);
 			}
 		}
-		while (dfm09_decode(dfm09decoder, &data, srcbuf, len) != PROCEED) {
-			if (data.fields) {
-				log_info("Autodetected: DFM09");
-				set_active_decoder(DFM09);
-				break;
-			}
+		if (ctx->running != (ctx->candidates | ctx->locked)) {
+			ctx->running = ctx->candidates | ctx->locked;
+			publish_snapshot(ctx);
 		}
-		while (imet4_decode(imet4decoder, &data, srcbuf, len) != PROCEED) {
-			if (data.fields) {
-				log_info("Autodetected: iMet-4");
-				set_active_decoder(IMET4);
-				break;
+		release_idle(ctx);
+
+		if (ctx->pool) autodetect_parallel(ctx, srcbuf, len);
+		ctx->auto_idx = 0;
+	}
+
+	/* Report one frame per call, resuming from where the previous call left */
+	for (; ctx->auto_idx < (int)LEN(_decoders); ctx->auto_idx++) {
+		i = ctx->auto_idx;
+
+		if (ctx->pool) {
+			worker = &ctx->pool[i];
+			if (worker->queue_read == worker->queue_count && worker->queue_full) {
+				worker->queue_count = worker->queue_read = 0;
+				semaphore_post(&worker->start);
+				semaphore_wait(&ctx->pool_done);
 			}
-		}
-		while (c50_decode(c50decoder, &data, srcbuf, len) != PROCEED) {
-			if (data.fields) {
-				log_info("Autodetected: SRS C50");
-				set_active_decoder(C50);
-				break;
+			if (worker->queue_read < worker->queue_count) {
+				data_received(ctx, _decoders[i].type, &worker->queue[worker->queue_read++]);
+				return PARSED;
 			}
+			continue;
 		}
-		while (mrzn1_decode(mrzn1decoder, &data, srcbuf, len) != PROCEED) {
+
+		if (!(ctx->running & (1 << _decoders[i].type))) continue;
+		if (!(instance = get_instance(ctx, i))) continue;
+
+		while (_decoders[i].decode(instance, &data, srcbuf, len) != PROCEED) {
 			if (data.fields) {
-				log_info("Autodetected: MRZ-N1");
-				set_active_decoder(MRZN1);
-				break;
+				data_received(ctx, _decoders[i].type, &data);
+				return PARSED;
 			}
 		}
-		break;
-	default:
-		while (active_decoder_decode(active_decoder_ctx, &data, srcbuf, len) != PROCEED) {
-			append_data_point(&data);
-			return PARSED;
-		}
-		break;
 	}
+
+	ctx->auto_idx = -1;
 	return PROCEED;
 }
 
-enum decoder
-get_active_decoder(void)
+static void
+data_received(SondeDecoderCtx *ctx, enum decoder type, SondeData *data)
 {
-	return active_decoder;
-}
+	SondeState *sonde;
+	int i;
 
-void
-set_active_decoder(enum decoder decoder)
-{
-	if (decoder == active_decoder) return;
+	if (!data->fields) return;
+
+	ctx->last_used[type] = ctx->sample_time;
+	if (ctx->active_decoder == AUTO) {
+		if (!(ctx->locked & (1 << type))) {
+			for (i=0; i<(int)LEN(_decoders) && _decoders[i].type != type; i++);
+			if (i < (int)LEN(_decoders)) log_info("Autodetected: %s", _decoders[i].name);
+			ctx->locked |= 1 << type;
+		}
+		ctx->lock_time[type] = ctx->sample_time;
+	}
 
-	/* Signal that pointers are okay again */
-	active_decoder = (decoder + END) % END;
-	memset(&printable, 0, sizeof(printable));
-	decoder_changed = 1;
-	sample_count = 0;
+	if ((sonde = route_data(ctx, type, data))) {
+		append_data_point(ctx, sonde, data);
+	}
 }
 
-const SondeData*
-get_data(void)
+static SondeState*
+route_data(SondeDecoderCtx *ctx, enum decoder type, const SondeData *data)
 {
-	return &printable;
-}
+	SondeState *prev = ctx->current[type];
+	SondeState *sonde = prev;
+	SondeState tmp;
 
-int
-get_slot(void) {
-	return sample_count;
-}
+	if (data->fields & DATA_SERIAL) {
+		if (!sonde || strcmp(sonde->serial, data->serial)) {
+			sonde = sonde_lookup(ctx, type, data->serial);
+
+			/* Data received before the serial number was known belongs to
+			 * this sonde, if it's a new one: swap the placeholder's track
+			 * into it, leaving the placeholder empty */
+			if (sonde && prev && !prev->serial[0] && !track_count(&sonde->track)) {
+				tmp = *sonde;
+				sonde->printable = prev->printable;
+				sonde->track = prev->track;
+				prev->printable = tmp.printable;
+				prev->track = tmp.track;
+			}
+		}
+	} else if (!sonde) {
+		sonde = sonde_lookup(ctx, type, "");
+	}
 
-int
-get_data_count(void)
-{
-	return sample_count;
+	ctx->current[type] = sonde;
+	return sonde;
 }
 
-const GeoPoint*
-get_track_data(void)
+static SondeState*
+sonde_lookup(SondeDecoderCtx *ctx, enum decoder type, const char *serial)
 {
-	return track;
+	SondeState *sonde, *oldest;
+	uint32_t hash;
+	int i, j;
+
+	/* FNV-1a over decoder type and serial number */
+	hash = (2166136261u ^ type) * 16777619u;
+	for (i=0; serial[i]; i++) {
+		hash = (hash ^ (uint8_t)serial[i]) * 16777619u;
+	}
+
+	/* Linear probing. Entries are never removed, only recycled once the map
+	 * is full, so the probe sequence of a key can only end on an empty slot,
+	 * a match, or after visiting all slots */
+	oldest = NULL;
+	for (i=0; i<SONDE_MAP_SIZE; i++) {
+		sonde = &ctx->sondes[(hash + i) & (SONDE_MAP_SIZE - 1)];
+
+		if (!sonde->used) break;
+		if (sonde->type == type && !strcmp(sonde->serial, serial)) return sonde;
+		if (!oldest || sonde->last_update < oldest->last_update) oldest = sonde;
+	}
+
+	/* Map full: recycle the least recently updated sonde */
+	if (i == SONDE_MAP_SIZE) {
+		sonde = oldest;
+		log_debug("Evicting %s", sonde->serial);
+		for (j=0; j<END; j++) {
+			if (ctx->current[j] == sonde) ctx->current[j] = NULL;
+		}
+		if (ctx->latest == sonde) ctx->latest = NULL;
+	}
+
+	sonde->used = 1;
+	sonde->type = type;
+	strncpy(sonde->serial, serial, sizeof(sonde->serial) - 1);
+	sonde->serial[sizeof(sonde->serial) - 1] = 0;
+	sonde->last_update = ctx->sample_time;
+	memset(&sonde->printable, 0, sizeof(sonde->printable));
+	track_clear(&sonde->track);
+
+	return sonde;
 }
 
-/* Static functions {{{ */
 static void
-append_data_point(SondeData *data)
+append_data_point(SondeDecoderCtx *ctx, SondeState *sonde, SondeData *data)
 {
+	const GeoPoint *prev;
+	GeoPoint point;
+
 	/* If no new data available, return */
 	if (!data->fields) return;
 
 	/* Copy data from previous sample */
-	if (sample_count) {
-		memcpy(&track[sample_count], &track[sample_count-1], sizeof(track[sample_count]));
+	prev = track_get(&sonde->track, track_count(&sonde->track) - 1);
+	if (prev) {
+		point = *prev;
+	} else {
+		memset(&point, 0, sizeof(point));
 	}
 
 	/* Add track point to list {{{ */
 	if (data->fields & DATA_PTU) {
-		track[sample_count].temp = data->temp;
-		track[sample_count].rh = data->rh;
-		track[sample_count].pressure = data->pressure;
-		track[sample_count].dewpt = dewpt(data->temp, data->rh);
-		track[sample_count].pressure = data->pressure;
-
-		printable.fields |= DATA_PTU;
-		printable.temp = data->temp;
-		printable.rh = data->rh;
-		printable.pressure = data->pressure;
-
-		printable.calib_percent = data->calib_percent;
+		point.temp = data->temp;
+		point.rh = data->rh;
+		point.pressure = data->pressure;
+		point.dewpt = dewpt(data->temp, data->rh);
+		point.pressure = data->pressure;
+
+		sonde->printable.fields |= DATA_PTU;
+		sonde->printable.temp = data->temp;
+		sonde->printable.rh = data->rh;
+		sonde->printable.pressure = data->pressure;
+
+		sonde->printable.calib_percent = data->calib_percent;
 	}
 
 	if (data->fields & DATA_TIME) {
-		track[sample_count].utc_time = data->time;
+		point.utc_time = data->time;
 
-		printable.fields |= DATA_TIME;
-		printable.time = data->time;
+		sonde->printable.fields |= DATA_TIME;
+		sonde->printable.time = data->time;
 	}
 
 	if (data->fields & DATA_POS) {
-		track[sample_count].lat = data->lat;
-		track[sample_count].lon = data->lon;
-		track[sample_count].alt = data->alt;
-
-		printable.fields |= DATA_POS;
-		printable.lat = data->lat;
-		printable.lon = data->lon;
-		printable.alt = data->alt;
+		point.lat = data->lat;
+		point.lon = data->lon;
+		point.alt = data->alt;
+
+		sonde->printable.fields |= DATA_POS;
+		sonde->printable.lat = data->lat;
+		sonde->printable.lon = data->lon;
+		sonde->printable.alt = data->alt;
 	}
 
 	if (data->fields & DATA_SPEED) {
-		track[sample_count].spd = data->speed;
-		track[sample_count].hdg = data->heading;
-		track[sample_count].climb = data->climb;
-
-		printable.fields |= DATA_SPEED;
-		printable.speed = data->speed;
-		printable.heading = data->heading;
-		printable.climb = data->climb;
+		point.spd = data->speed;
+		point.hdg = data->heading;
+		point.climb = data->climb;
+
+		sonde->printable.fields |= DATA_SPEED;
+		sonde->printable.speed = data->speed;
+		sonde->printable.heading = data->heading;
+		sonde->printable.climb = data->climb;
 	}
 
 	if (data->fields & DATA_SERIAL) {
-		printable.fields |= DATA_SERIAL;
-		strncpy(printable.serial, data->serial, sizeof(printable.serial) - 1);
-		printable.serial[sizeof(printable.serial) - 1] = 0;
+		sonde->printable.fields |= DATA_SERIAL;
+		strncpy(sonde->printable.serial, data->serial, sizeof(sonde->printable.serial) - 1);
+		sonde->printable.serial[sizeof(sonde->printable.serial) - 1] = 0;
 	}
 
 	if (data->fields & DATA_OZONE) {
-		printable.fields |= DATA_OZONE;
-		printable.o3_mpa = data->o3_mpa;
+		sonde->printable.fields |= DATA_OZONE;
+		sonde->printable.o3_mpa = data->o3_mpa;
 	}
 
 	if (data->fields & DATA_SHUTDOWN) {
-		printable.fields |= DATA_SHUTDOWN;
-		printable.shutdown = data->shutdown;
+		sonde->printable.fields |= DATA_SHUTDOWN;
+		sonde->printable.shutdown = data->shutdown;
 	}
 
 	if (data->fields & DATA_SEQ) {
@@ -351,28 +844,65 @@ append_data_point(SondeData *data)
 		 * sequence number, but sondes like the DFM roll over every 256
 		 * packets, which is not nearly enough to uniquely identify
 		 * every packet sent during a flight */
-		track[sample_count].id = MAX((uint32_t)data->seq, sample_count ? track[sample_count - 1].id + 1 : 0);
+		point.id = MAX((uint32_t)data->seq, prev ? prev->id + 1 : 0);
 
-		printable.fields |= DATA_SEQ;
-		printable.seq = data->seq;
-	} else if (sample_count) {
-		track[sample_count].id = track[sample_count - 1].id + 1;
+		sonde->printable.fields |= DATA_SEQ;
+		sonde->printable.seq = data->seq;
+	} else if (prev) {
+		point.id = prev->id + 1;
 	} else {
-		track[sample_count].id = 0;
+		point.id = 0;
 	}
 	/* }}} */
 
 	/* If pressure data is unavailable, derive it from the reported
 	 * altitude */
-	if (!(printable.pressure > 0)) {
-		printable.pressure = altitude_to_pressure(printable.alt);
-		track[sample_count].pressure = printable.pressure;
+	if (!(sonde->printable.pressure > 0)) {
+		sonde->printable.pressure = altitude_to_pressure(sonde->printable.alt);
+		point.pressure = sonde->printable.pressure;
 	}
 
-	sample_count++;
-	if (sample_count >= reserved_count) {
-		reserved_count += CHUNKSIZE;
-		track = realloc(track, reserved_count * sizeof(*track));
+	if (track_push(&sonde->track, &point)) {
+		log_warn("Could not append point to track");
 	}
+
+	sonde->last_update = ctx->sample_time;
+	ctx->latest = sonde;
+	atomics_store(&ctx->update_count, ctx->update_count + 1);
+	publish_snapshot(ctx);
+}
+
+static void
+switch_decoder(SondeDecoderCtx *ctx, enum decoder decoder)
+{
+	atomics_store(&ctx->active_decoder, decoder);
+	get_decoder(ctx, decoder, &ctx->active_decoder_decode, &ctx->active_decoder_ctx);
+
+	ctx->candidates = ctx->all_candidates;
+	ctx->running = decoder == AUTO ? ctx->candidates : 0;
+	ctx->locked = 0;
+	ctx->auto_idx = -1;
+
+	publish_snapshot(ctx);
+}
+
+static void
+publish_snapshot(SondeDecoderCtx *ctx)
+{
+	DecoderSnapshot *snap = &ctx->snapshots[ctx->snap_back];
+
+	if (ctx->latest) {
+		snap->data = ctx->latest->printable;
+		snap->track_count = track_count(&ctx->latest->track);
+	} else {
+		memset(&snap->data, 0, sizeof(snap->data));
+		snap->track_count = 0;
+	}
+	snap->active = ctx->active_decoder;
+	snap->running = ctx->running;
+	snap->slot = ctx->update_count;
+	snap->generation = ++ctx->snap_generation;
+
+	ctx->snap_back = atomics_exchange(&ctx->snap_middle, ctx->snap_back | SNAPSHOT_DIRTY) & ~SNAPSHOT_DIRTY;
 }
 /* }}} */
@@ -5,25 +5,129 @@
 
 #define decoder_iface_t ParserStatus(*)(void*, SondeData*, const float*, size_t)
 
+enum decoder { AUTO=0, C50, DFM09, IMET4, IMS100, M10, MRZN1, RS41, END};
+
+/**
+ * Consistent copy of the latest decoded data, for threads other than the one
+ * running the decoder
+ */
 typedef struct {
-	unsigned int id;
-	time_t utc_time;
-	float lat, lon, alt;
-	float spd, hdg, climb;
-	float pressure;
-	float temp, rh, dewpt;
-} GeoPoint;
+	SondeData data;         /* Latest data of the most recently updated sonde */
+	int track_count;        /* Number of points in its track */
+	int slot;               /* Value of the update counter when this was taken */
+	int generation;         /* Incremented on every publish, data or decoder state */
+	enum decoder active;    /* Active decoder */
+	uint32_t running;       /* Bitmask of the decoders AUTO mode is running: the ones
+	                         * the signal pre-classifier could not rule out, plus the
+	                         * ones that decoded a frame recently */
+} DecoderSnapshot;
 
-enum decoder { AUTO=0, C50, DFM09, IMET4, IMS100, M10, MRZN1, RS41, END};
+/**
+ * Check whether a decoder was compiled in
+ *
+ * @param type decoder to check
+ * @return 1 if the decoder can be selected, 0 otherwise
+ */
+int decoder_is_available(enum decoder type);
+
+/**
+ * Decoder context: one per input stream. Owns the per-sonde decoders, the
+ * decoded track and the latest printable data
+ */
+typedef struct sondedecoderctx SondeDecoderCtx;
+
+/**
+ * Create a new decoder context. The sample rate is fixed for the lifetime of
+ * the context: to decode a stream at a different rate, create a new one
+ *
+ * @param samplerate sample rate of the input stream
+ * @return the new context, or NULL on failure
+ */
+SondeDecoderCtx* decoder_ctx_init(int samplerate);
+
+/**
+ * Free all the resources associated with a decoder context
+ *
+ * @param ctx context to free, can be NULL
+ */
+void             decoder_ctx_deinit(SondeDecoderCtx *ctx);
+
+/**
+ * Decode samples from the stream associated with the context
+ *
+ * @param ctx decoder context
+ * @param samples samples to decode
+ * @param len number of samples
+ * @return PROCEED if the samples have been fully processed, PARSED if new
+ *         data might be available
+ */
+ParserStatus     decoder_ctx_decode(SondeDecoderCtx *ctx, const float *samples, size_t len);
+
+/**
+ * Enable/disable parallel autodetection. When enabled, in AUTO mode each
+ * buffer is handed to all decoders at once, each running on its own worker
+ * thread
+ *
+ * @param ctx decoder context
+ * @param enable 1 to enable, 0 to disable
+ * @return 0 on success, non-zero on failure
+ */
+int              decoder_ctx_set_parallel(SondeDecoderCtx *ctx, int enable);
+
+/**
+ * Set how long a decoder can go without producing any data before it's freed.
+ * Decoders are created on first use, either when selected or when AUTO mode
+ * tries them. The selected decoder, and the ones AUTO mode is running, are
+ * never freed
+ *
+ * @param ctx decoder context
+ * @param seconds idle time after which a decoder is freed, 0 to never free
+ */
+void             decoder_ctx_set_idle_timeout(SondeDecoderCtx *ctx, int seconds);
 
+/**
+ * Get/set the active decoder. Safe to call from any thread: the switch is
+ * carried out by the next decoder_ctx_decode() call, and a pending switch is
+ * already reported by decoder_ctx_get_active()
+ */
+enum decoder     decoder_ctx_get_active(const SondeDecoderCtx *ctx);
+void             decoder_ctx_set_active(SondeDecoderCtx *ctx, enum decoder decoder);
+
+/**
+ * Get the data of the most recently updated sonde
+ */
+const SondeData* decoder_ctx_get_data(const SondeDecoderCtx *ctx);
+
+/**
+ * Get the number of data points decoded so far, across all sondes. Changes
+ * every time decoder_ctx_get_data() would return new data. Safe to call from
+ * any thread
+ *
+ * @param ctx decoder context
+ * @return update counter
+ */
+int              decoder_ctx_get_update_count(const SondeDecoderCtx *ctx);
+
+/**
+ * Get a snapshot of the latest decoded data without blocking the decoder.
+ * Unlike decoder_ctx_get_data(), this can be called from a thread other than
+ * the one running the decoder, but only from one such thread per context.
+ * The snapshot stays valid until the next call.
+ *
+ * @param ctx decoder context
+ * @return latest snapshot published by the decoder
+ */
+const DecoderSnapshot* decoder_ctx_get_snapshot(SondeDecoderCtx *ctx);
+
+/**
+ * Single-stream API, operating on a process-wide default context
+ */
 int          decoder_init(int samplerate);
 void         decoder_deinit(void);
 ParserStatus decode(const float *samples, size_t len);
 
-/**
- * Thread-safe way to change the decoder sample rate
- */
-void         decoder_set_samplerate(int samplerate);
+int          decoder_set_parallel(int enable);
+void         decoder_set_idle_timeout(int seconds);
 
 /**
  * Getter/setter for the currently active decoder
@@ -32,12 +136,11 @@ enum decoder get_active_decoder(void);
 void         set_active_decoder(enum decoder decoder);
 
 /**
- * Get a pointer to the data decoded so far
+ * Get a pointer to the data decoded so far. Only valid on the thread calling
+ * decode(): other threads should use get_snapshot()
  */
 const SondeData* get_data(void);
 int              get_slot(void);
-
-int             get_data_count(void);
-const GeoPoint* get_track_data(void);
+const DecoderSnapshot* get_snapshot(void);
 
 #endif
@@ -0,0 +1,87 @@
+#include <string.h>
+#include "accumulator.h"
+
+static void merge_fields(SondeData *dst, const SondeData *src, DataBitmask fields);
+static void emit(Accumulator *acc, SondeData *dst);
+
+void
+accumulator_init(Accumulator *acc, DataBitmask complete)
+{
+	memset(&acc->record, 0, sizeof(acc->record));
+	acc->pending = 0;
+	acc->complete = complete;
+}
+
+int
+accumulator_push(Accumulator *acc, SondeData *dst, SondeData *src)
+{
+	const DataBitmask fields = src->fields;
+	int boundary;
+
+	dst->fields = 0;
+	src->fields = 0;
+
+	/* A new time or sequence number marks the start of the next observation:
+	 * emit whatever was collected for the current one first */
+	boundary = (fields & acc->pending & DATA_TIME && src->time != acc->record.time)
+	        || (fields & acc->pending & DATA_SEQ && src->seq != acc->record.seq);
+
+	if (boundary) emit(acc, dst);
+
+	merge_fields(&acc->record, src, fields);
+	acc->pending |= fields;
+
+	/* If this completes a record and none was emitted yet, emit it now. If
+	 * one was, the new record goes out with the next push */
+	if (!boundary && acc->pending && (acc->pending & acc->complete) == acc->complete) {
+		emit(acc, dst);
+	}
+
+	return dst->fields != 0;
+}
+
+/* Static functions {{{ */
+static void
+merge_fields(SondeData *dst, const SondeData *src, DataBitmask fields)
+{
+	if (fields & DATA_SEQ) {
+		dst->seq = src->seq;
+	}
+	if (fields & DATA_SERIAL) {
+		memcpy(dst->serial, src->serial, sizeof(dst->serial));
+	}
+	if (fields & DATA_POS) {
+		dst->lat = src->lat;
+		dst->lon = src->lon;
+		dst->alt = src->alt;
+	}
+	if (fields & DATA_SPEED) {
+		dst->speed = src->speed;
+		dst->climb = src->climb;
+		dst->heading = src->heading;
+	}
+	if (fields & DATA_TIME) {
+		dst->time = src->time;
+	}
+	if (fields & DATA_PTU) {
+		dst->calib_percent = src->calib_percent;
+		dst->temp = src->temp;
+		dst->rh = src->rh;
+		dst->pressure = src->pressure;
+	}
+	if (fields & DATA_OZONE) {
+		dst->o3_mpa = src->o3_mpa;
+	}
+	if (fields & DATA_SHUTDOWN) {
+		dst->shutdown = src->shutdown;
+	}
+}
+
+static void
+emit(Accumulator *acc, SondeData *dst)
+{
+	memcpy(dst, &acc->record, sizeof(*dst));
+	dst->fields = acc->pending;
+	acc->pending = 0;
+}
+/* }}} */
@@ -0,0 +1,40 @@
+#ifndef accumulator_h
+#define accumulator_h
+
+#include "include/data.h"
+
+/**
+ * Collects the fields carried by a sequence of partial frames into a single
+ * record, for sondes that spread one observation across several of them
+ */
+typedef struct {
+	SondeData record;       /* Most recent value of each field */
+	DataBitmask pending;    /* Fields updated since the last record was emitted */
+	DataBitmask complete;   /* Fields that, once all updated, complete a record */
+} Accumulator;
+
+/**
+ * Initialize an accumulator
+ *
+ * @param acc accumulator to initialize
+ * @param complete set of fields that must all be updated before a record is
+ *                 emitted
+ */
+void accumulator_init(Accumulator *acc, DataBitmask complete);
+
+/**
+ * Merge the fields flagged in src into the record being accumulated, and
+ * clear src->fields. A record is emitted when all the fields in the
+ * completion set have been updated, or when src carries a time or sequence
+ * number different from the pending one, in which case the pending record is
+ * emitted before merging src.
+ *
+ * @param acc accumulator to use
+ * @param dst pointer to the record to fill. dst->fields is set to the fields
+ *            updated since the previous record, or to 0 if nothing was emitted
+ * @param src partial data to merge
+ * @return 1 if a record was emitted, 0 otherwise
+ */
+int accumulator_push(Accumulator *acc, SondeData *dst, SondeData *src);
+
+#endif
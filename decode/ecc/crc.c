@@ -1,77 +1,112 @@
 #include "crc.h"
+#include "tables.h"
 
-#define CCITT_FALSE_POLY 0x1021
 #define CCITT_FALSE_INIT 0xFFFF
-#define AUG_CCITT_POLY   0x1021
 #define AUG_CCITT_INIT   0x1D0F
-#define MODBUS_POLY      0xA001
 #define MODBUS_INIT      0xFFFF
 
-static uint16_t crc16(uint16_t init, uint16_t poly, const void *data, size_t len);
-static uint16_t crc16_refin_refout(uint16_t init, uint16_t poly, const void *vdata, size_t len);
+#define FCS16_BLOCK 16
 
+static uint16_t crc16(const uint16_t table[CRC16_SLICES][256], uint16_t init, const void *data, size_t len);
+static uint16_t crc16_refin_refout(const uint16_t table[CRC16_SLICES][256], uint16_t init, const void *vdata, size_t len);
+
+/* Slicing-by-8 lookup tables are generated at build time (see tables.h).
+ * CCITT-FALSE and AUG-CCITT share the same polynomial, so they share the
+ * same table too */
 uint16_t
 crc16_ccitt_false(const void *data, size_t len)
 {
-	return crc16(CCITT_FALSE_INIT, CCITT_FALSE_POLY, data, len);
+	return crc16(crc16_ccitt_table, CCITT_FALSE_INIT, data, len);
 }
 
 uint16_t
 crc16_aug_ccitt(const void *data, size_t len)
 {
-	return crc16(AUG_CCITT_INIT, AUG_CCITT_POLY, data, len);
+	return crc16(crc16_ccitt_table, AUG_CCITT_INIT, data, len);
 }
 
 uint16_t
 crc16_modbus(const void *data, size_t len)
 {
-	return crc16_refin_refout(MODBUS_INIT, MODBUS_POLY, data, len);
+	return crc16_refin_refout(crc16_modbus_table, MODBUS_INIT, data, len);
 }
 
 uint16_t
 fcs16(const void *v_data, size_t len)
 {
 	const uint8_t *data = v_data;
-	uint8_t sum[2] = {0, 0};
+	uint32_t sum0, sum1;
+	uint32_t block_sum, block_weighted;
+	int i;
 
+	/* Sums are mod 256, so they can be accumulated in wider integers and
+	 * truncated at the end */
+	sum0 = sum1 = 0;
+
+	/* Consume FCS16_BLOCK bytes per iteration: each byte is added to sum1
+	 * once for itself and once for every byte following it in the block.
+	 * The inner loop has no carried dependency, so it can be vectorized */
+	for (; len >= FCS16_BLOCK; len -= FCS16_BLOCK, data += FCS16_BLOCK) {
+		block_sum = block_weighted = 0;
+		for (i=0; i<FCS16_BLOCK; i++) {
+			block_sum += data[i];
+			block_weighted += (FCS16_BLOCK - i) * data[i];
+		}
+		sum1 += FCS16_BLOCK * sum0 + block_weighted;
+		sum0 += block_sum;
+	}
+
+	/* Leftover bytes */
 	for (; len>0; len--) {
-		sum[0] += *data++;
-		sum[1] += sum[0];
+		sum0 += *data++;
+		sum1 += sum0;
 	}
 
-	return sum[0] << 8 | sum[1];
+	return (sum0 & 0xFF) << 8 | (sum1 & 0xFF);
 }
 
 /* Static functions {{{ */
 static uint16_t
-crc16(uint16_t init, uint16_t poly, const void *vdata, size_t len)
+crc16(const uint16_t table[CRC16_SLICES][256], uint16_t init, const void *vdata, size_t len)
 {
 	const uint8_t *data = vdata;
 	uint16_t crc = init;
-	int i;
 
-	for(; len > 0; len--) {
-		crc ^= *data++ << 8;
-		for (i=0; i<8; i++) {
-			crc = crc & 0x8000 ? (crc << 1) ^ poly : (crc << 1);
-		}
+	/* Consume 8 bytes per iteration: the first two are folded into the
+	 * current CRC, the others only depend on their distance from the end of
+	 * the block */
+	for (; len >= CRC16_SLICES; len -= CRC16_SLICES, data += CRC16_SLICES) {
+		crc ^= data[0] << 8 | data[1];
+		crc = table[7][crc >> 8] ^ table[6][crc & 0xFF]
+		    ^ table[5][data[2]] ^ table[4][data[3]]
+		    ^ table[3][data[4]] ^ table[2][data[5]]
+		    ^ table[1][data[6]] ^ table[0][data[7]];
+	}
+
+	/* Leftover bytes */
+	for (; len > 0; len--) {
+		crc = (crc << 8) ^ table[0][(crc >> 8) ^ *data++];
 	}
 
 	return crc;
 }
 
 static uint16_t
-crc16_refin_refout(uint16_t init, uint16_t poly, const void *vdata, size_t len)
+crc16_refin_refout(const uint16_t table[CRC16_SLICES][256], uint16_t init, const void *vdata, size_t len)
 {
 	const uint8_t *data = vdata;
 	uint16_t crc = init;
-	int i;
 
-	for(; len > 0; len--) {
-		crc ^= *data++;
-		for (i=0; i<8; i++) {
-			crc = crc & 0x0001 ? (crc >> 1) ^ poly : (crc >> 1);
-		}
+	for (; len >= CRC16_SLICES; len -= CRC16_SLICES, data += CRC16_SLICES) {
+		crc ^= data[0] | data[1] << 8;
+		crc = table[7][crc & 0xFF] ^ table[6][crc >> 8]
+		    ^ table[5][data[2]] ^ table[4][data[3]]
+		    ^ table[3][data[4]] ^ table[2][data[5]]
+		    ^ table[1][data[6]] ^ table[0][data[7]];
+	}
+
+	for (; len > 0; len--) {
+		crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xFF];
 	}
 
 	return crc;
@@ -2,12 +2,13 @@
 #include <stdint.h>
 #include <string.h>
 #include "rs.h"
+#include "tables.h"
 #include "utils.h"
 
 static uint8_t gfmul(uint8_t x, uint8_t y, const uint8_t *alpha, const uint8_t *logtable, int n);
 static uint8_t gfdiv(uint8_t x, uint8_t y, const uint8_t *alpha, const uint8_t *logtable, int n);
 static uint8_t gfpow(uint8_t x, int exp, const uint8_t *alpha, const uint8_t *logtable, int n);
-static int rs_init_internal(RSDecoder *d, int n, int k, unsigned gen_poly);
+static void rs_init_internal(RSDecoder *d, const GFTables *tables);
 static void poly_deriv(uint8_t *dst, const uint8_t *poly, int len);
 static uint8_t poly_eval(const uint8_t *poly, uint8_t x, int len, const uint8_t *alpha, const uint8_t *logtable, int n);
 static void poly_mul(uint8_t *dst, const uint8_t *poly1, const uint8_t *poly2, int len_1, int len_2, const uint8_t *alpha, const uint8_t *logtable, int n);
@@ -15,99 +16,46 @@ static void poly_mul(uint8_t *dst, const uint8_t *poly1, const uint8_t *poly2, i
 int
 rs_init(RSDecoder *d, int n, int k, unsigned gen_poly, uint8_t first_root, int root_skip)
 {
-	const int t = n - k;
-	int i, exp;
-	int ret;
-
-	ret = rs_init_internal(d, n, k, gen_poly);
-
-	d->first_root = first_root;
-	d->t = t;
-
-	/* Compute polynomial roots */
-	for (i=0; i<t; i++) {
-		exp = ((i + first_root) * root_skip) % n;
-		d->zeroes[i] = d->alpha[exp];
-	}
-
-	/* Initialize the gap'th log table */
-	for (i=0; i<n+1; i++) {
-		d->gaproots[gfpow(i, root_skip, d->alpha, d->logtable, n)] = i;
-	}
-
-	return ret;
-}
-
-int
-bch_init(RSDecoder *d, int n, int k, unsigned gen_poly, const uint8_t *roots, int root_count)
-{
+	const GFTables *tables;
 	int i;
-	int ret;
-
-	ret = rs_init_internal(d, n, k, gen_poly);
-	memcpy(d->zeroes, roots, root_count * sizeof(roots[0]));
-	d->first_root = -1;
-	d->t = root_count;
-
-	/* Initialize the gap'th log table */
-	for (i=0; i<n+1; i++) {
-		d->gaproots[i] = i;
-	}
-
-	return ret;
-}
-
-int
-rs_init_internal(RSDecoder *d, int n, int k, unsigned gen_poly)
-{
-	int i;
-	unsigned tmp;
-
-	if (!(d->alpha = malloc(n+1))) return 1;
-	if (!(d->logtable = malloc(n+1))) return 1;
-	if (!(d->zeroes = malloc(n+1))) return 1;
-	if (!(d->gaproots = malloc(n+1))) return 1;
 
-	d->n = n;
-	d->k = k;
-
-	/* Initialize alpha and logtable */
-	d->alpha[0] = 1;
-	d->logtable[1] = 0;
-
-	for (i=1; i<n+1; i++) {
-		tmp = (int)d->alpha[i-1] << 1;
-		tmp = (tmp >= (unsigned)n+1 ? tmp ^ gen_poly : tmp);
-		d->alpha[i] = tmp;
-		d->logtable[tmp] = i;
+	for (i=0; i<gf_tables_count; i++) {
+		tables = &gf_tables[i];
+		if (tables->n == n && tables->k == k && tables->gen_poly == gen_poly
+		 && tables->first_root == first_root && tables->root_skip == root_skip) {
+			rs_init_internal(d, tables);
+			return 0;
+		}
 	}
 
-
-	return 0;
+	return 1;
 }
 
 void
 rs_deinit(RSDecoder *d)
 {
-	free(d->alpha);
-	free(d->logtable);
-	free(d->zeroes);
-	free(d->gaproots);
+	/* Tables are statically allocated, nothing to free */
+	(void)d;
 }
 
 int
 rs_fix_block(const RSDecoder *self, uint8_t *data)
+{
+	return rs_fix_block_erasures(self, data, NULL, 0);
+}
+
+int
+rs_fix_block_erasures(const RSDecoder *self, uint8_t *data, const int *erasures, int erasure_count)
 {
 	const int rs_n = self->n;
 	const int rs_t = self->t;
-	const int rs_t2 = rs_t / 2;
 	const uint8_t *alpha = self->alpha;
 	const uint8_t *logtable = self->logtable;
 	const uint8_t *gaproots = self->gaproots;
 	const uint8_t *zeroes = self->zeroes;
-	const size_t sizeof_lambda = rs_t2 + 1;
+	const size_t sizeof_lambda = rs_t + 1;
 
-	int i, m, n, delta, prev_delta;
+	int i, j, m, n, delta, prev_delta;
 	int lambda_deg;
 	int has_errors;
 	int error_count;
@@ -115,7 +63,11 @@ rs_fix_block(const RSDecoder *self, uint8_t *data)
 	uint8_t lambda[256], prev_lambda[256], tmp[256];
 	uint8_t lambda_root[256], error_pos[256];
 	uint8_t omega[256], lambda_prime[256];
-	uint8_t num, den, fcr;
+	uint8_t num, den, fcr, locator;
+
+	if (erasure_count > rs_t) {
+		return -1;
+	}
 
 	/* Compute syndromes */
 	has_errors = 0;
@@ -127,15 +79,25 @@ rs_fix_block(const RSDecoder *self, uint8_t *data)
 		return 0;
 	}
 
-	/* Berlekamp-Massey algorithm */
+	/* Initialize lambda with the erasure locator polynomial, which is the
+	 * product of (1 + Xj*x) for each erased position j */
 	memset(lambda, 0, sizeof_lambda);
-	memset(prev_lambda, 0, sizeof_lambda);
-	lambda_deg = 0;
+	lambda[0] = 1;
+	for (j=0; j<erasure_count; j++) {
+		locator = alpha[(erasures[j] * self->root_skip) % rs_n];
+		for (i=j+1; i>0; i--) {
+			lambda[i] ^= gfmul(lambda[i-1], locator, alpha, logtable, rs_n);
+		}
+	}
+
+	/* Berlekamp-Massey algorithm, skipping the first erasure_count steps
+	 * since the erasure locator already accounts for those */
+	memcpy(prev_lambda, lambda, sizeof_lambda);
+	lambda_deg = erasure_count;
 	prev_delta = 1;
-	lambda[0] = prev_lambda[0] = 1;
 	m = 1;
 
-	for (n=0; n<rs_t; n++) {
+	for (n=erasure_count; n<rs_t; n++) {
 		delta = syndrome[n];
 		for (i=1; i<=lambda_deg; i++) {
 			delta ^= gfmul(syndrome[n-i], lambda[i], alpha, logtable, rs_n);
@@ -143,26 +105,26 @@ rs_fix_block(const RSDecoder *self, uint8_t *data)
 
 		if (delta == 0) {
 			m++;
-		} else if (2*lambda_deg <= n) {
-			for (i=0; i<rs_t2+1; i++) {
+		} else if (2*lambda_deg <= n + erasure_count) {
+			for (i=0; i<rs_t+1; i++) {
 				tmp[i] = lambda[i];
 			}
-			for (i=m; i<rs_t2+1; i++) {
+			for (i=m; i<rs_t+1; i++) {
 				lambda[i] ^= gfmul(
 						gfdiv(delta, prev_delta, alpha, logtable, rs_n),
 						prev_lambda[i-m],
 						alpha, logtable, rs_n
 						);
 			}
-			for (i=0; i<rs_t2+1; i++) {
+			for (i=0; i<rs_t+1; i++) {
 				prev_lambda[i] = tmp[i];
 			}
 
 			prev_delta = delta;
-			lambda_deg = n + 1 - lambda_deg;
+			lambda_deg = n + 1 + erasure_count - lambda_deg;
 			m = 1;
 		} else {
-			for (i=m; i<rs_t2+1; i++) {
+			for (i=m; i<rs_t+1; i++) {
 				lambda[i] ^= gfmul(
 						gfdiv(delta, prev_delta, alpha, logtable, rs_n),
 						prev_lambda[i-m],
@@ -172,10 +134,15 @@ rs_fix_block(const RSDecoder *self, uint8_t *data)
 		}
 	}
 
+	/* Each error costs two syndromes, each erasure only one */
+	if (2*(lambda_deg - erasure_count) + erasure_count > rs_t) {
+		return -1;
+	}
+
 	/* Roots bruteforcing */
 	error_count = 0;
 	for (i=1; i<=rs_n && error_count < lambda_deg; i++) {
-		if (poly_eval(lambda, i, rs_t2+1, alpha, logtable, rs_n) == 0) {
+		if (poly_eval(lambda, i, rs_t+1, alpha, logtable, rs_n) == 0) {
 			lambda_root[error_count] = i;
 			error_pos[error_count] = logtable[gaproots[gfdiv(1, i, alpha, logtable, rs_n)]];
 			error_count++;
@@ -186,31 +153,41 @@ rs_fix_block(const RSDecoder *self, uint8_t *data)
 		return -1;
 	}
 
-	poly_mul(omega, syndrome, lambda, rs_t, rs_t2+1, alpha, logtable, rs_n);
-	poly_deriv(lambda_prime, lambda, rs_t2+1);
+	poly_mul(omega, syndrome, lambda, rs_t, rs_t+1, alpha, logtable, rs_n);
+	poly_deriv(lambda_prime, lambda, rs_t+1);
 
 	/* Fix errors in the block */
 	for (i=0; i<error_count; i++) {
-		if (self->first_root >= 0) {
-			/* lambda_root[i] = 1/Xi, Xi being the i-th error locator */
-			fcr = gfpow(lambda_root[i], (self->first_root - 1 + rs_n) % rs_n, alpha, logtable, rs_n);
-			num = poly_eval(omega, lambda_root[i], rs_t, alpha, logtable, rs_n);
-			den = poly_eval(lambda_prime, lambda_root[i], rs_t2, alpha, logtable, rs_n);
-
-			data[error_pos[i]] ^= gfdiv(
-					gfmul(num, fcr, alpha, logtable, rs_n),
-					den,
-					alpha, logtable, rs_n
-					);
-		} else {
-			/* BCH code */
-			data[error_pos[i]] ^= 0x1;
-		}
+		/* lambda_root[i] = 1/Xi, Xi being the i-th error locator */
+		fcr = gfpow(lambda_root[i], (self->first_root - 1 + rs_n) % rs_n, alpha, logtable, rs_n);
+		num = poly_eval(omega, lambda_root[i], rs_t, alpha, logtable, rs_n);
+		den = poly_eval(lambda_prime, lambda_root[i], rs_t, alpha, logtable, rs_n);
+
+		data[error_pos[i]] ^= gfdiv(
+				gfmul(num, fcr, alpha, logtable, rs_n),
+				den,
+				alpha, logtable, rs_n
+				);
 	}
 
 	return error_count;
 }
 
+/* Static functions {{{ */
+static void
+rs_init_internal(RSDecoder *d, const GFTables *tables)
+{
+	d->n = tables->n;
+	d->k = tables->k;
+	d->t = tables->root_count;
+	d->first_root = tables->first_root;
+	d->root_skip = tables->root_skip;
+	d->alpha = tables->alpha;
+	d->logtable = tables->logtable;
+	d->zeroes = tables->zeroes;
+	d->gaproots = tables->gaproots;
+}
+
 static uint8_t
 poly_eval(const uint8_t *poly, uint8_t x, int len, const uint8_t *alpha, const uint8_t *logtable, int n)
 {
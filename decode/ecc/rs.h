@@ -5,12 +5,13 @@
 #include <stdlib.h>
 
 typedef struct {
-	int n, k, t, first_root;
-	uint8_t *alpha, *logtable, *zeroes, *gaproots;
+	int n, k, t, first_root, root_skip;
+	const uint8_t *alpha, *logtable, *zeroes, *gaproots;
 } RSDecoder;
 
 /**
- * Initialize the given Reed-Solomon decoder
+ * Initialize the given Reed-Solomon decoder. Galois field tables are not
+ * computed at runtime, but looked up among the ones generated at build time
  *
  * @param d decoder to initialize
  * @param n message length, in symbols
@@ -18,21 +19,10 @@ typedef struct {
  * @param gen_poly generator polynomial
  * @param first_root first root of the generator to use
  * @param root_skip distance between consecutive roots
+ * @return 0 on success, 1 if no matching tables were generated for this code
  */
 int rs_init(RSDecoder *d, int n, int k, unsigned gen_poly, uint8_t first_root, int root_skip);
 
-/**
- * Initialize the given Reed-Solomon decoder, in BCH mode
- *
- * @param d decoder to initialize
- * @param n message length, in symbols
- * @param k payload length, in symbols
- * @param gen_poly generator polynomial
- * @param roots roots of the generator to use
- * @param root_count number of roots in *roots
- */
-int bch_init(RSDecoder *d, int n, int k, unsigned gen_poly, const uint8_t *roots, int root_count);
-
 /**
  * Deinitialize the Reed-Solomon decoder
  *
@@ -52,4 +42,20 @@ void rs_deinit(RSDecoder *d);
  */
 int rs_fix_block(const RSDecoder *d, uint8_t *c);
 
+/**
+ * Attempt to fix the data inside a block, given the position of some of the
+ * symbols that are known to be unreliable. Each erasure only costs one parity
+ * symbol instead of two, so up to t erasures can be corrected in the absence
+ * of other errors.
+ *
+ * @param d the RS decoder to use
+ * @param c the block to error correct. If all errors can be corrected, bytes
+ *          will be modified in-place.
+ * @param erasures positions of the unreliable symbols within the block
+ * @param erasure_count number of entries in *erasures
+ * @return -1  errors could not be corrected
+ *         >=0 number of symbols corrected
+ */
+int rs_fix_block_erasures(const RSDecoder *d, uint8_t *c, const int *erasures, int erasure_count);
+
 #endif
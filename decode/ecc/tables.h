@@ -0,0 +1,55 @@
+#ifndef ecc_tables_h
+#define ecc_tables_h
+
+/**
+ * Read-only ECC lookup tables. The definitions are emitted at build time by
+ * tablegen (see tablegen/tablegen.c), so that decoders don't have to compute
+ * them at runtime.
+ */
+
+#include <stdint.h>
+
+#define CRC16_SLICES 8
+#define IMS100_BCH_SYNDROME_BYTES 6
+
+#define HAMMING_CORRECTED     0x01
+#define HAMMING_UNCORRECTABLE 0x02
+
+typedef struct {
+	int n, k;
+	unsigned gen_poly;
+	int first_root;
+	int root_skip;
+	int root_count;
+	const uint8_t *alpha;       /* n+1 entries */
+	const uint8_t *logtable;    /* n+1 entries */
+	const uint8_t *zeroes;      /* root_count entries */
+	const uint8_t *gaproots;    /* n+1 entries */
+} GFTables;
+
+/* Galois field tables for each code used by the decoders */
+extern const GFTables gf_tables[];
+extern const int gf_tables_count;
+
+/* iMS100 BCH(63,51) syndrome tables. The first one maps each byte of a packed
+ * 46-bit message (LSB first) to its syndrome contribution, S1 | S3 << 6. The
+ * second one maps a syndrome to the bits to flip, encoded as
+ * count << 12 | bit2 << 6 | bit1. An entry of 0 means uncorrectable */
+extern const uint16_t ims100_bch_syndrome_table[IMS100_BCH_SYNDROME_BYTES][256];
+extern const uint16_t ims100_bch_error_table[1 << 12];
+
+/* DFM Hamming(8,4) decoding table: maps each received byte to its corrected
+ * data nibble (upper 4 bits), plus HAMMING_* flags in the lower 4 bits */
+extern const uint8_t dfm09_hamming_table[256];
+
+/* M10/M20 checksum tables. Each step maps the 16-bit state c and the input
+ * byte b to (c & 0xFF) << 8 | (data[b] ^ lo[c & 0xFF] ^ hi[c >> 8]) */
+extern const uint8_t m10_checksum_data_table[256];
+extern const uint8_t m10_checksum_lo_table[256];
+extern const uint8_t m10_checksum_hi_table[256];
+
+/* Slicing-by-8 CRC16 tables */
+extern const uint16_t crc16_ccitt_table[CRC16_SLICES][256];
+extern const uint16_t crc16_modbus_table[CRC16_SLICES][256];
+
+#endif
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 #include "bitops.h"
 #include "framer.h"
@@ -17,6 +18,7 @@ framer_init_gfsk(Framer *f, int samplerate, int baudrate, size_t framelen, uint6
 	f->state = READ;
 	f->offset = 0;
 	f->framelen = framelen;
+	f->weak = NULL;
 
 	return 0;
 }
@@ -30,6 +32,7 @@ framer_init_afsk(Framer *f, int samplerate, int baudrate, size_t framelen, float
 	f->state = READ;
 	f->offset = 0;
 	f->framelen = framelen;
+	f->weak = NULL;
 
 	return 0;
 }
@@ -37,6 +40,9 @@ framer_init_afsk(Framer *f, int samplerate, int baudrate, size_t framelen, float
 void
 framer_deinit(Framer *f)
 {
+	free(f->weak);
+	f->weak = NULL;
+
 	switch (f->type) {
 	case GFSK:
 		gfsk_deinit(&f->demod.gfsk);
@@ -47,6 +53,17 @@ framer_deinit(Framer *f)
 	}
 }
 
+int
+framer_track_weak_bits(Framer *f)
+{
+	if (f->type != GFSK) return 1;
+
+	/* Large enough for a frame plus the worst-case sync offset */
+	if (!f->weak && !(f->weak = calloc(2 * f->framelen / 8 + 1, 1))) return 1;
+
+	return 0;
+}
+
 ParserStatus
 framer_read(Framer *f, void *v_dst, const float *src, size_t len)
 {
@@ -61,8 +78,10 @@ framer_read(Framer *f, void *v_dst, const float *src, size_t len)
 
 		if (f->framelen % 8) {
 			bitcpy(dst, dst, f->framelen, f->offset);
+			if (f->weak) bitcpy(f->weak, f->weak, f->framelen, f->offset);
 		} else {
 			memcpy(dst, dst + f->framelen/8, f->offset/8+1);
+			if (f->weak) memcpy(f->weak, f->weak + f->framelen/8, f->offset/8+1);
 		}
 
 		f->state = READ;
@@ -91,7 +110,10 @@ framer_read(Framer *f, void *v_dst, const float *src, size_t len)
 		}
 
 		/* Realign frame to the beginning of the buffer */
-		if (f->sync_offset) bitcpy(dst, dst, f->sync_offset, f->framelen);
+		if (f->sync_offset) {
+			bitcpy(dst, dst, f->sync_offset, f->framelen);
+			if (f->weak) bitcpy(f->weak, f->weak, f->sync_offset, f->framelen);
+		}
 
 		/* Undo inversion */
 		if (f->inverted) {
@@ -121,6 +143,7 @@ framer_adjust(Framer *f, void *v_dst, size_t bits_delta)
 
 	/* Shift bits by the specified amount */
 	bitcpy(dst, dst, bits_delta, valid_bits - bits_delta);
+	if (f->weak) bitcpy(f->weak, f->weak, bits_delta, valid_bits - bits_delta);
 
 	/* De-invert if necessary */
 	if (f->inverted) {
@@ -142,7 +165,7 @@ framer_demod_internal(Framer *f, void *dst, size_t *bit_offset, size_t framelen,
 {
 	switch (f->type) {
 	case GFSK:
-		return gfsk_demod(&f->demod.gfsk, dst, bit_offset, framelen, src, len);
+		return gfsk_demod(&f->demod.gfsk, dst, f->weak, bit_offset, framelen, src, len);
 	case AFSK:
 		return afsk_demod(&f->demod.afsk, dst, bit_offset, framelen, src, len);
 	default:
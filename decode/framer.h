@@ -24,6 +24,7 @@ typedef struct {
 	size_t offset;
 	size_t framelen;
 	int inverted;
+	uint8_t *weak;      /* Bitmap of low-confidence bits, NULL if not tracked */
 } Framer;
 
 /**
@@ -62,6 +63,16 @@ int framer_init_afsk(Framer *f, int samplerate, int baudrate, size_t framelen, f
  */
 void framer_deinit(Framer *f);
 
+/**
+ * Enable tracking of low-confidence bits. Once a frame is decoded, f->weak
+ * holds a bitmap aligned to it, with a bit set for each unreliable bit.
+ * Only supported by GFSK framers.
+ *
+ * @param f framer to enable tracking on
+ * @return 0 on success, nonzero otherwise
+ */
+int framer_track_weak_bits(Framer *f);
+
 /**
  * Decode a frame, aligning the synchranization marker to the beginning of the
  * given buffer
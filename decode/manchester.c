@@ -4,23 +4,33 @@
 
 void
 manchester_decode(void *dst, const void *src, int nbits)
+{
+	manchester_decode_violations(dst, NULL, src, nbits);
+}
+
+void
+manchester_decode_violations(void *dst, void *violations, const void *src, int nbits)
 {
 	uint8_t *raw_dst = (uint8_t*)dst;
-	uint8_t out;
+	uint8_t *raw_violations = (uint8_t*)violations;
+	uint8_t out, out_violations;
 	uint8_t inBits;
 	int i, out_count;
 
-	out = 0;
+	out = out_violations = 0;
 	out_count = 0;
 	for (i=0; i<nbits; i+=2) {
 		bitcpy(&inBits, src, i, 2);
 		out = (out << 1) | (inBits & 0x40 ? 1 : 0);
+		out_violations = (out_violations << 1) | (((inBits >> 7) ^ (inBits >> 6)) & 0x1 ? 0 : 1);
 		out_count++;
 
 		if (!(out_count % 8)) {
 			*raw_dst++ = out;
-			out = 0;
+			if (raw_violations) *raw_violations++ = out_violations;
+			out = out_violations = 0;
 		}
 	}
 	*raw_dst = out;
+	if (raw_violations) *raw_violations = out_violations;
 }
@@ -12,4 +12,15 @@
  */
 void manchester_decode(void *dst, const void *src, int nbits);
 
+/**
+ * Manchester decode bits, flagging invalid bit pairs (00 or 11)
+ *
+ * @param dst destination buffer to write bits to
+ * @param violations destination bitmap, parallel to dst, where a bit will be
+ *                   set for each invalid pair
+ * @param src source buffer to read bit pairs from
+ * @param nbits number of bits to decode (= output bits)
+ */
+void manchester_decode_violations(void *dst, void *violations, const void *src, int nbits);
+
 #endif
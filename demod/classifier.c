@@ -0,0 +1,165 @@
+#include <math.h>
+#include <string.h>
+#include "classifier.h"
+#include "utils.h"
+
+#define CLASSIFIER_WINDOW 0.25      /* Seconds of samples per decision */
+#define CLASSIFIER_DC_TAU 0.02      /* DC removal time constant, seconds */
+#define CLASSIFIER_LPF_CUTOFF 8000  /* Noise filter cutoff, Hz */
+#define CLASSIFIER_HYSTERESIS 0.5   /* Crossing hysteresis, relative to the mean amplitude */
+#define CLASSIFIER_TOLERANCE 0.06   /* Relative tolerance on crossing intervals */
+#define CLASSIFIER_MIN_CROSSINGS 100
+#define CLASSIFIER_MIN_SCORE 0.6    /* Min fraction of intervals the best class must explain */
+#define CLASSIFIER_RELATIVE_SCORE 0.75  /* Min score relative to the best class */
+
+static void classifier_add(Classifier *c, uint32_t id, const float *intervals, int count);
+static void classifier_update(Classifier *c, float interval);
+static void classifier_decide(Classifier *c);
+
+void
+classifier_init(Classifier *c, int samplerate)
+{
+	memset(c, 0, sizeof(*c));
+	c->dc_alpha = 1.0f / (CLASSIFIER_DC_TAU * samplerate);
+	c->lpf_alpha = 1 - expf(-2 * M_PI * MIN(CLASSIFIER_LPF_CUTOFF, samplerate / 2) / samplerate);
+	c->window_len = CLASSIFIER_WINDOW * samplerate;
+	c->side = 1;
+	c->match = 0;
+}
+
+void
+classifier_add_gfsk(Classifier *c, uint32_t id, int samplerate, int baudrate, int manchester)
+{
+	const float t = (float)samplerate / baudrate;
+	const float intervals[] = {t, 2*t, 3*t, 4*t};
+
+	/* Manchester coding limits runs to two chips */
+	classifier_add(c, id, intervals, manchester ? 2 : 4);
+}
+
+void
+classifier_add_afsk(Classifier *c, uint32_t id, int samplerate, float f_mark, float f_space)
+{
+	/* Zero crossings are spaced by half a period of either tone */
+	const float intervals[] = {samplerate / (2 * f_mark), samplerate / (2 * f_space)};
+
+	classifier_add(c, id, intervals, 2);
+}
+
+int
+classifier_feed(Classifier *c, const float *src, size_t len)
+{
+	int updated = 0;
+	float sample, frac;
+	size_t i;
+
+	for (i=0; i<len; i++) {
+		/* Remove DC offset (carrier frequency error) and high-frequency noise */
+		c->dc += (src[i] - c->dc) * c->dc_alpha;
+		c->lpf += (src[i] - c->dc - c->lpf) * c->lpf_alpha;
+		sample = c->lpf;
+		c->env += (fabsf(sample) - c->env) * c->dc_alpha;
+
+		c->since_crossing++;
+
+		/* Only accept a zero crossing once the signal has moved well away from
+		 * zero since the previous one, so that noise around the crossing
+		 * point does not split intervals */
+		if (sample * c->side > CLASSIFIER_HYSTERESIS * c->env) c->armed = 1;
+
+		/* On zero crossing, interpolate the exact crossing time and classify
+		 * the interval since the previous one */
+		if ((sample >= 0 ? 1 : -1) != c->side) {
+			if (c->armed) {
+				frac = sample / (sample - c->prev);
+				classifier_update(c, c->since_crossing - frac);
+				c->since_crossing = frac;
+				c->side = -c->side;
+				c->armed = 0;
+			}
+		}
+		c->prev = sample;
+
+		if (++c->window_offset >= c->window_len) {
+			classifier_decide(c);
+			c->window_offset = 0;
+			updated = 1;
+		}
+	}
+
+	return updated;
+}
+
+uint32_t
+classifier_match(const Classifier *c)
+{
+	uint32_t all = 0;
+	int i;
+
+	if (c->match) return c->match;
+
+	for (i=0; i<c->class_count; i++) {
+		all |= c->classes[i].id;
+	}
+	return all;
+}
+
+/* Static functions {{{ */
+static void
+classifier_add(Classifier *c, uint32_t id, const float *intervals, int count)
+{
+	ClassifierClass *cls;
+
+	if (c->class_count >= CLASSIFIER_MAX_CLASSES) return;
+
+	cls = &c->classes[c->class_count++];
+	cls->id = id;
+	cls->interval_count = count;
+	memcpy(cls->intervals, intervals, count * sizeof(*intervals));
+}
+
+static void
+classifier_update(Classifier *c, float interval)
+{
+	const ClassifierClass *cls;
+	int i, j;
+
+	c->crossings++;
+
+	for (i=0; i<c->class_count; i++) {
+		cls = &c->classes[i];
+		for (j=0; j<cls->interval_count; j++) {
+			if (fabsf(interval - cls->intervals[j]) <= CLASSIFIER_TOLERANCE * cls->intervals[j]) {
+				c->counts[i]++;
+				break;
+			}
+		}
+	}
+}
+
+static void
+classifier_decide(Classifier *c)
+{
+	int i, best;
+
+	best = 0;
+	for (i=0; i<c->class_count; i++) {
+		best = MAX(best, c->counts[i]);
+	}
+
+	c->match = 0;
+
+	/* Only narrow down the candidates if the signal is clearly explained by
+	 * at least one of the classes */
+	if (c->crossings >= CLASSIFIER_MIN_CROSSINGS && best >= CLASSIFIER_MIN_SCORE * c->crossings) {
+		for (i=0; i<c->class_count; i++) {
+			if (c->counts[i] >= CLASSIFIER_RELATIVE_SCORE * best) {
+				c->match |= c->classes[i].id;
+			}
+		}
+	}
+
+	memset(c->counts, 0, sizeof(c->counts));
+	c->crossings = 0;
+}
+/* }}} */
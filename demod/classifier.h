@@ -0,0 +1,87 @@
+#ifndef classifier_h
+#define classifier_h
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define CLASSIFIER_MAX_CLASSES 16
+#define CLASSIFIER_MAX_INTERVALS 4
+
+/**
+ * Line code of a signal class, described by the intervals between
+ * consecutive zero crossings of the FM-demodulated signal it produces
+ */
+typedef struct {
+	uint32_t id;
+	float intervals[CLASSIFIER_MAX_INTERVALS];
+	int interval_count;
+} ClassifierClass;
+
+typedef struct {
+	ClassifierClass classes[CLASSIFIER_MAX_CLASSES];
+	int class_count;
+
+	float dc, lpf, env, prev;
+	float dc_alpha, lpf_alpha;
+	float since_crossing;
+	int side, armed;
+
+	int counts[CLASSIFIER_MAX_CLASSES];
+	int crossings;
+	size_t window_len, window_offset;
+
+	uint32_t match;
+} Classifier;
+
+/**
+ * Initialize a signal classifier
+ *
+ * @param c classifier to initialize
+ * @param samplerate input sample rate
+ */
+void classifier_init(Classifier *c, int samplerate);
+
+/**
+ * Register a GFSK/NRZ signal class
+ *
+ * @param c classifier to add the class to
+ * @param id bit(s) to report when the class matches
+ * @param samplerate input sample rate
+ * @param baudrate line rate (chip rate for Manchester-coded signals)
+ * @param manchester whether the signal is Manchester coded (runs of at most
+ *        two chips)
+ */
+void classifier_add_gfsk(Classifier *c, uint32_t id, int samplerate, int baudrate, int manchester);
+
+/**
+ * Register an AFSK signal class
+ *
+ * @param c classifier to add the class to
+ * @param id bit(s) to report when the class matches
+ * @param samplerate input sample rate
+ * @param f_mark mark frequency
+ * @param f_space space frequency
+ */
+void classifier_add_afsk(Classifier *c, uint32_t id, int samplerate, float f_mark, float f_space);
+
+/**
+ * Analyze samples. Every time enough samples have been analyzed, a new set of
+ * matching classes is computed
+ *
+ * @param c classifier to use
+ * @param src FM-demodulated samples
+ * @param len number of samples
+ * @return 1 if the set of matching classes was updated, 0 otherwise
+ */
+int classifier_feed(Classifier *c, const float *src, size_t len);
+
+/**
+ * Get the ids of the classes the signal might belong to. If the signal could
+ * not be classified (e.g. only noise), all classes are reported
+ *
+ * @param c classifier to query
+ * @return OR of the ids of the matching classes
+ */
+uint32_t classifier_match(const Classifier *c);
+
+#endif
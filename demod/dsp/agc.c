@@ -4,7 +4,6 @@
 #include "utils.h"
 #include "log/log.h"
 
-#define FLOAT_TARGET_MAG 5
 #define BIAS_POLE 0.01f
 #define GAIN_POLE 0.001f
 
@@ -2,6 +2,8 @@
 #define agc_h
 #include <complex.h>
 
+#define FLOAT_TARGET_MAG 5
+
 typedef struct {
 	float bias;
 	float moving_avg;
@@ -53,7 +53,7 @@ gfsk_deinit(GFSKDemod *g)
 }
 
 ParserStatus
-gfsk_demod(GFSKDemod *g, void *v_dst, size_t *bit_offset, size_t count, const float *src, size_t len)
+gfsk_demod(GFSKDemod *g, void *v_dst, uint8_t *weak, size_t *bit_offset, size_t count, const float *src, size_t len)
 {
 	uint8_t *dst = v_dst;
 	float symbol;
@@ -103,6 +103,15 @@ gfsk_demod(GFSKDemod *g, void *v_dst, size_t *bit_offset, size_t count, const fl
 				fprintf(debug, "%f,%f\n", symbol, symbol);
 #endif
 
+				/* Flag symbols too close to the decision threshold */
+				if (weak) {
+					if (fabsf(symbol) < GFSK_WEAK_THRESHOLD) {
+						weak[*bit_offset/8] |= 0x80 >> (*bit_offset%8);
+					} else {
+						weak[*bit_offset/8] &= ~(0x80 >> (*bit_offset%8));
+					}
+				}
+
 				/* Slice sample to get bit value */
 				tmp = (tmp << 1) | (symbol > 0 ? 1 : 0);
 				(*bit_offset)++;
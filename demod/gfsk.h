@@ -12,6 +12,7 @@
 #define GFSK_SYM_ZETA 0.707
 #define BUFLEN 1024
 #define MIN_SAMPLES_PER_SYMBOL 8
+#define GFSK_WEAK_THRESHOLD (0.2f * FLOAT_TARGET_MAG)   /* Below this, a symbol is unreliable */
 
 typedef struct {
 	int samplerate, symrate;
@@ -40,6 +41,8 @@ void gfsk_deinit(GFSKDemod *g);
  * Demod bits from a GFSK-coded sample stream
  *
  * @param dst destination buffer where the bits will be written to
+ * @param weak optional bitmap, parallel to dst, where bits whose symbol
+ *             magnitude is below GFSK_WEAK_THRESHOLD will be set. Can be NULL
  * @param bit_offset offset from the start of dst where bits should be written, in bits
  * @param count number of bits to decode
  * @param src pointer to samples to demodulate
@@ -47,6 +50,6 @@ void gfsk_deinit(GFSKDemod *g);
  *
  * @return offset of the last bit decoded
  */
-ParserStatus gfsk_demod(GFSKDemod *g, void *dst, size_t *bit_offset, size_t count, const float *src, size_t len);
+ParserStatus gfsk_demod(GFSKDemod *g, void *dst, uint8_t *weak, size_t *bit_offset, size_t count, const float *src, size_t len);
 
 #endif
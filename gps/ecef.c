@@ -2,6 +2,12 @@
 #include "ecef.h"
 #include "utils.h"
 
+/* Maximum latitude drift before the local tangent plane scale factors are
+ * recomputed, in degrees (~5.5km) */
+#define ENU_REF_MAX_DRIFT 0.05
+
+static void enu_velocity_set_ref(ENUVelocity *v, float lat);
+
 int
 ecef_to_lla(float *lat, float *lon, float *alt, float x, float y, float z)
 {
@@ -68,7 +74,7 @@ lla_to_ecef(float *x, float *y, float *z, float lat, float lon, float alt)
 	/* Compute x, y, z */
 	*x = (n + alt) * cosf(lat) * cosf(lon);
 	*y = (n + alt) * cosf(lat) * sinf(lon);
-	*z = (1 - WGS84_E_SQR) * (n + alt) * sinf(lat);
+	*z = ((1 - WGS84_E_SQR) * n + alt) * sinf(lat);
 
 	return 0;
 }
@@ -105,3 +111,72 @@ lla_to_aes(float *az, float *el, float *slant, float lat, float lon, float alt,
 	return 0;
 }
 
+
+void
+enu_velocity_init(ENUVelocity *v)
+{
+	v->valid = 0;
+	v->ref_lat = NAN;
+}
+
+int
+enu_velocity_update(ENUVelocity *v, float *speed, float *heading, float *v_climb, float lat, float lon, float alt, time_t time)
+{
+	float dt, dlat, north, east;
+	double dlon;
+
+	/* First fix, or time going backwards (e.g. new sonde): restart */
+	if (!v->valid || time < v->time) {
+		v->valid = 1;
+		v->lat = lat;
+		v->lon = lon;
+		v->alt = alt;
+		v->time = time;
+		return 1;
+	}
+
+	/* Duplicate fix: keep the previous one as the reference */
+	if (time == v->time) return 1;
+
+	if (!(fabsf(lat - v->ref_lat) <= ENU_REF_MAX_DRIFT)) {
+		enu_velocity_set_ref(v, lat);
+	}
+
+	dt = time - v->time;
+	dlat = lat - v->lat;
+	/* Unwrap in double precision, so that crossing the antimeridian does not
+	 * cost a few meters of resolution */
+	dlon = (double)lon - v->lon;
+	if (dlon > 180) dlon -= 360;
+	else if (dlon < -180) dlon += 360;
+
+	/* Small displacement: arc lengths along the meridian and the parallel */
+	north = dlat * (float)(M_PI/180) * (v->meridional_radius + alt);
+	east = dlon * (float)(M_PI/180) * (v->normal_radius + alt) * v->coslat;
+
+	*speed = sqrtf(north*north + east*east) / dt;
+	*heading = atan2f(east, north) * 180/M_PI;
+	if (*heading < 0) *heading += 360;
+	*v_climb = (alt - v->alt) / dt;
+
+	v->lat = lat;
+	v->lon = lon;
+	v->alt = alt;
+	v->time = time;
+
+	return 0;
+}
+
+/* Static functions {{{ */
+static void
+enu_velocity_set_ref(ENUVelocity *v, float lat)
+{
+	const float sinlat = sinf(lat * M_PI/180);
+	const float w = 1 - WGS84_E_SQR * sinlat*sinlat;
+
+	v->ref_lat = lat;
+	v->coslat = cosf(lat * M_PI/180);
+	v->normal_radius = WGS84_A / sqrtf(w);
+	v->meridional_radius = v->normal_radius * (1 - WGS84_E_SQR) / w;
+}
+/* }}} */
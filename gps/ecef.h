@@ -1,6 +1,8 @@
 #ifndef ecef_h
 #define ecef_h
 
+#include <time.h>
+
 #define WGS84_A 6378137.0
 #define WGS84_F (1 / 298.257223563)
 #define WGS84_B (WGS84_A * (1 - WGS84_F))
@@ -9,6 +11,16 @@
 #define WGS84_E_PRIME_SQR ((WGS84_A*WGS84_A - WGS84_B*WGS84_B)/(WGS84_B*WGS84_B))
 #define WGS84_E_PRIME (sqrtf(WGS84_E_PRIME))
 
+typedef struct {
+	int valid;
+	float lat, lon, alt;
+	time_t time;
+
+	/* Local tangent plane scale factors, computed at a reference latitude */
+	float ref_lat;
+	float meridional_radius, normal_radius, coslat;
+} ENUVelocity;
+
 /**
  * Convert ECEF coordinates to lat/lon/alt
  *
@@ -68,4 +80,29 @@ int lla_to_ecef(float *x, float *y, float *z, float lat, float lon, float alt);
  */
 int lla_to_aes(float *az, float *el, float *slant, float lat, float lon, float alt, float lat_0, float lon_0, float alt_0);
 
+/**
+ * Initialize an incremental velocity estimator
+ *
+ * @param v estimator to initialize
+ */
+void enu_velocity_init(ENUVelocity *v);
+
+/**
+ * Estimate speed/heading/climb rate from the displacement between the given
+ * position fix and the previous one, projected onto the local tangent plane
+ *
+ * @param v estimator to use
+ * @param speed pointer to speed, in m/s
+ * @param heading pointer to heading, in degrees (0..360)
+ * @param v_climb pointer to vertical climb, in m/s
+ * @param lat latitude, in degrees
+ * @param lon longitude, in degrees
+ * @param alt altitude, in meters
+ * @param time time of the fix
+ *
+ * @return 0 on success, 1 if no estimate is available (first fix, or time not
+ *         strictly increasing)
+ */
+int enu_velocity_update(ENUVelocity *v, float *speed, float *heading, float *v_climb, float lat, float lon, float alt, time_t time);
+
 #endif
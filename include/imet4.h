@@ -29,7 +29,8 @@ void imet4_decoder_deinit(IMET4Decoder *d);
  * @param len number of samples available
  *
  * @return PROCEED if the src buffer has been fully processed
- *         PARSED  if a frame has been decoded into *dst
+ *         PARSED  if a subframe has been decoded. dst->fields is non-zero
+ *                 only once a full observation has been collected
  */
 ParserStatus imet4_decode(IMET4Decoder *d, SondeData *dst, const float *src, size_t len);
 
@@ -18,6 +18,7 @@
 #include "io/wavfile.h"
 #include "log/log.h"
 #include "physics.h"
+#include "sonde/calibstore.h"
 #include "utils.h"
 #ifdef ENABLE_TUI
 #include "tui/tui.h"
@@ -31,7 +32,7 @@
 
 #define BUFLEN 1024
 
-#define SHORTOPTS "a:c:f:g:hk:l:o:qr:t:Tuv"
+#define SHORTOPTS "a:C:c:f:g:hi:k:l:o:Pqr:t:Tuv"
 
 /* UI types */
 enum ui {
@@ -73,14 +74,17 @@ static struct option longopts[] = {
 #ifdef ENABLE_AUDIO
 	{ "audio-device", 1, NULL, 'a' },
 #endif
+	{ "calib-dir",    1, NULL, 'C' },
 	{ "fmt",          1, NULL, 'f' },
 	{ "csv",          1, NULL, 'c' },
 	{ "decoders",     1, NULL, 'd' },
 	{ "gpx",          1, NULL, 'g' },
 	{ "help",         0, NULL, 'h' },
+	{ "idle-timeout", 1, NULL, 'i' },
 	{ "kml",          1, NULL, 'k' },
 	{ "live-kml",     1, NULL, 'l' },
 	{ "output",       1, NULL, 'o' },
+	{ "parallel",     0, NULL, 'P' },
 	{ "quiet",        0, NULL, 'q' },
 	{ "location",     1, NULL, 'r' },
 	{ "type",         1, NULL, 't' },
@@ -120,6 +124,8 @@ main(int argc, char *argv[])
 	int receiver_location_set = 0;
 #endif
 	enum decoder active_decoder = AUTO;
+	int parallel = 0;
+	int idle_timeout = 0;
 	float receiver_lat = 0, receiver_lon = 0, receiver_alt = 0;
 #ifdef ENABLE_AUDIO
 	input_type = INPUT_AUDIO;
@@ -137,6 +143,9 @@ main(int argc, char *argv[])
 			audio_device = atoi(optarg);
 			break;
 #endif
+		case 'C':
+			calibstore_set_dir(optarg);
+			break;
 		case 'c':
 			csv_fname = optarg;
 			break;
@@ -156,6 +165,10 @@ main(int argc, char *argv[])
 				usage(argv[0]);
 				return 1;
 			}
+			if (!decoder_is_available(active_decoder)) {
+				fprintf(stderr, "Decoder not compiled in: %s\n", optarg);
+				return 1;
+			}
 			break;
 #ifdef ENABLE_TUI
 		case 'T':
@@ -176,6 +189,12 @@ main(int argc, char *argv[])
 			output_fmt = optarg;
 			ui = UI_TEXT;
 			break;
+		case 'i':
+			idle_timeout = atoi(optarg);
+			break;
+		case 'P':
+			parallel = 1;
+			break;
 		case 'q':
 			log_enable(0);
 			break;
@@ -299,6 +318,10 @@ main(int argc, char *argv[])
 		return 1;
 	}
 	set_active_decoder(active_decoder);
+	decoder_set_idle_timeout(idle_timeout);
+	if (parallel && decoder_set_parallel(1)) {
+		log_warn("Failed to start autodetection threads, falling back to sequential");
+	}
 
 #ifdef ENABLE_TUI
 	/* Enable TUI */
@@ -332,11 +355,11 @@ main(int argc, char *argv[])
 		/* Send them to decoder */
 		while (decode(srcbuf, LEN(srcbuf)) != PROCEED) {
 			/* If no new data, immediately go to next iteration */
-			if (data_count == get_data_count()) {
+			if (data_count == get_slot()) {
 				continue;
 			}
 
-			data_count = get_data_count();
+			data_count = get_slot();
 			data = get_data();
 
 			if (ui == UI_TEXT) {
@@ -384,6 +407,7 @@ main(int argc, char *argv[])
 #endif
 	/* Deinit decoder */
 	decoder_deinit();
+	calibstore_set_dir(NULL);
 
 	return 0;
 }
@@ -422,21 +446,38 @@ usage(const char *pname)
 #ifdef ENABLE_AUDIO
 			"   -a, --audio-device <id>      Use PortAudio device <id> as input (default: choose interactively)\n"
 #endif
+			"   -C, --calib-dir <dir>        Save/restore sonde calibration data in <dir>\n"
 			"   -c, --csv <file>             Output data to <file> in CSV format\n"
 			"   -f, --fmt <format>           Format output lines as <format>\n"
 			"   -g, --gpx <file>             Output GPX track to <file>\n"
+			"   -i, --idle-timeout <s>       Free decoders idle for <s> seconds (default: never)\n"
 			"   -k, --kml <file>             Output KML track to <file>\n"
 			"   -l, --live-kml <file>        Output live KML track to <file>\n"
+			"   -P, --parallel               Run autodetection on multiple threads\n"
 			"   -r, --location <lat,lon,alt> Set receiver location to <lat, lon, alt> (default: none)\n"
 			"   -t, --type <type>            Enable decoder for the given sonde type. Supported values:\n"
 			"                                auto: Autodetect (default)\n"
+#ifdef ENABLE_C50
 			"                                c50: Meteolabor SRS-C50\n"
+#endif
+#ifdef ENABLE_DFM09
 			"                                dfm: GRAW DFM06/09\n"
+#endif
+#ifdef ENABLE_IMET4
 			"                                imet4: InterMet iMet-4\n"
+#endif
+#ifdef ENABLE_IMS100
 			"                                ims100: Meisei iMS-100/RS-11G\n"
+#endif
+#ifdef ENABLE_M10
 			"                                m10: MeteoModem M10/M20\n"
+#endif
+#ifdef ENABLE_MRZN1
 			"                                mrzn1: Meteo-Radiy MRZ-N1\n"
+#endif
+#ifdef ENABLE_RS41
 			"                                rs41: Vaisala RS41-SG(P,M)\n"
+#endif
 #ifdef ENABLE_TUI
 			"   -T, --tui                    Enable TUI display\n"
 #endif
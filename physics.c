@@ -3,15 +3,15 @@
 #include "utils.h"
 
 float
-altitude_to_pressure(float alt)
+altitude_to_pressure_exact(float alt)
 {
 	const float g0 = 9.80665;
 	const float M = 0.0289644;
 	const float R_star = 8.3144598;
 
-	const float hbs[] = {0.0,      11000.0, 20000.0, 32000.0, 47000.0, 51000.0, 77000.0};
+	const float hbs[] = {0.0,      11000.0, 20000.0, 32000.0, 47000.0, 51000.0, 71000.0};
 	const float Lbs[] = {-0.0065,  0.0,     0.001,   0.0028,  0.0,     -0.0028, -0.002};
-	const float Pbs[] = {101325.0, 22632.1, 5474.89, 868.02,  110.91,  66.94,   3.96};
+	const float Pbs[] = {101325.0, 22632.1, 5474.89, 868.02,  110.91,  66.94,   3.9564};
 	const float Tbs[] = {288.15,   216.65,  216.65,  228.65,  270.65,  270.65,  214.65};
 
 	float Lb, Pb, Tb, hb;
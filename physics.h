@@ -1,13 +1,40 @@
 #ifndef physics_h
 #define physics_h
 
+#define PRESSURE_TABLE_STEP 100     /* Altitude step between table entries (m) */
+#define PRESSURE_TABLE_LEN 851      /* 0-85km */
+
+/* Pressure at each altitude step, generated at build time by tablegen from
+ * altitude_to_pressure_exact() */
+extern const float altitude_pressure_table[PRESSURE_TABLE_LEN];
+
+/**
+ * Calculate pressure at a given altitude using the standard atmosphere model
+ *
+ * @param alt altitude
+ * @return pressure at that altitude (hPa)
+ */
+float altitude_to_pressure_exact(float alt);
+
 /**
- * Calculate pressure at a given altitude
+ * Calculate pressure at a given altitude, interpolating between precomputed
+ * values when possible. Relative error is below 1e-4 wrt the exact model
  *
  * @param alt altitude
  * @return pressure at that altitude (hPa)
  */
-float altitude_to_pressure(float alt);
+static inline float
+altitude_to_pressure(float alt)
+{
+	const float idx = alt / PRESSURE_TABLE_STEP;
+	int i;
+
+	if (!(idx >= 0) || idx >= PRESSURE_TABLE_LEN - 1) return altitude_to_pressure_exact(alt);
+
+	i = idx;
+	return altitude_pressure_table[i]
+	     + (altitude_pressure_table[i+1] - altitude_pressure_table[i]) * (idx - i);
+}
 
 /**
  * Calculate dew point
@@ -4,6 +4,7 @@
 #include "bitops.h"
 #include "frame.h"
 #include "protocol.h"
+#include "decode/accumulator.h"
 #include "decode/framer.h"
 #include "log/log.h"
 #include "physics.h"
@@ -15,6 +16,7 @@ struct c50decoder {
 	C50Frame frame;
 
 	SondeData partial_dst;
+	Accumulator acc;
 	struct tm time;
 };
 
@@ -33,8 +35,9 @@ c50_decoder_init(int samplerate)
 			C50_SYNCWORD, C50_SYNC_LEN);
 
 	memset(&d->partial_dst, 0, sizeof(d->partial_dst));
+	accumulator_init(&d->acc, DATA_TIME | DATA_POS | DATA_PTU);
 	memset(&d->time, 0, sizeof(d->time));
-	d->time = *gmtime(&zero);
+	my_gmtime_r(&zero, &d->time);
 
 #ifndef NDEBUG
 	debug = fopen("/tmp/c50frames.data", "wb");
@@ -129,9 +132,8 @@ c50_decode(C50Decoder *self, SondeData *dst, const float *src, size_t len)
 		break;
 	}
 
-	/* Copy from internal data buffer to output */
-	memcpy(dst, &self->partial_dst, sizeof(*dst));
-	self->partial_dst.fields = 0;
+	/* Output a record once a full set of fields has been received */
+	accumulator_push(&self->acc, dst, &self->partial_dst);
 
 	return PARSED;
 }
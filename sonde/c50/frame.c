@@ -5,6 +5,8 @@
 #include "decode/ecc/crc.h"
 #include "log/log.h"
 
+static int c50_type_is_known(uint8_t type);
+
 void
 c50_frame_descramble(C50Frame *dst, const C50RawFrame *src)
 {
@@ -29,6 +31,11 @@ c50_frame_correct(C50Frame *frame)
 	const uint16_t expected = frame->checksum[0] << 8 | (frame->checksum[1] ^ 0xFF);
 	uint16_t checksum;
 
+	/* Cheap check first: most false sync matches carry an unknown type */
+	if (!c50_type_is_known(frame->type)) {
+		return -1;
+	}
+
 	checksum = fcs16(&frame->type, sizeof(frame->type) + sizeof(frame->data));
 
 	if (checksum != expected) {
@@ -37,3 +44,27 @@ c50_frame_correct(C50Frame *frame)
 
 	return 0;
 }
+
+/* Static functions {{{ */
+static int
+c50_type_is_known(uint8_t type)
+{
+	switch (type) {
+	case C50_TYPE_TEMP_REF:
+	case C50_TYPE_TEMP_AIR:
+	case C50_TYPE_TEMP_HUM:
+	case C50_TYPE_TEMP_TOP:
+	case C50_TYPE_TEMP_O3_INTAKE:
+	case C50_TYPE_RH:
+	case C50_TYPE_DATE:
+	case C50_TYPE_TIME:
+	case C50_TYPE_LAT:
+	case C50_TYPE_LON:
+	case C50_TYPE_ALT:
+	case C50_TYPE_SN:
+		return 1;
+	default:
+		return 0;
+	}
+}
+/* }}} */
@@ -0,0 +1,165 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "calibstore.h"
+#include "log/log.h"
+
+#define CALIBSTORE_MAGIC "SDCL"
+#define CALIBSTORE_VERSION 1
+#define CALIBSTORE_EXT ".cal"
+
+/* Record layout: magic, version, fragment count, fragment size (LE),
+ * bitmap of the fragments present, followed by the fragments themselves */
+#define HEADER_VERSION_OFFSET 4
+#define HEADER_COUNT_OFFSET   5
+#define HEADER_SIZE_OFFSET    6
+#define HEADER_PRESENT_OFFSET 8
+#define HEADER_LEN (HEADER_PRESENT_OFFSET + CALIBSTORE_MAX_FRAGS/8)
+
+static char *_calib_dir;
+
+static void write_header(CalibStore *s);
+static int header_matches(const CalibStore *s, const uint8_t *header);
+
+void
+calibstore_set_dir(const char *path)
+{
+	free(_calib_dir);
+	_calib_dir = NULL;
+
+	if (path) {
+		_calib_dir = malloc(strlen(path) + 1);
+		strcpy(_calib_dir, path);
+	}
+}
+
+void
+calibstore_init(CalibStore *s, int frag_size, int frag_count)
+{
+	s->fd = NULL;
+	s->serial[0] = 0;
+	s->frag_size = frag_size;
+	s->frag_count = frag_count;
+	memset(s->present, 0, sizeof(s->present));
+}
+
+void
+calibstore_close(CalibStore *s)
+{
+	if (s->fd) fclose(s->fd);
+	s->fd = NULL;
+	s->serial[0] = 0;
+	memset(s->present, 0, sizeof(s->present));
+}
+
+int
+calibstore_open(CalibStore *s, const char *serial)
+{
+	char path[FILENAME_MAX];
+	char name[CALIBSTORE_SERIAL_LEN];
+	uint8_t header[HEADER_LEN];
+	int i;
+
+	if (!strncmp(s->serial, serial, sizeof(s->serial) - 1)) return 1;
+
+	calibstore_close(s);
+	strncpy(s->serial, serial, sizeof(s->serial) - 1);
+	s->serial[sizeof(s->serial) - 1] = 0;
+
+	if (!_calib_dir) return 0;
+
+	/* Build record path, replacing any character that might not be valid in
+	 * a filename */
+	for (i=0; s->serial[i]; i++) {
+		name[i] = isalnum((unsigned char)s->serial[i]) || s->serial[i] == '-' ? s->serial[i] : '_';
+	}
+	name[i] = 0;
+
+	if (strlen(_calib_dir) + 1 + strlen(name) + sizeof(CALIBSTORE_EXT) > sizeof(path)) {
+		log_warn("Calibration store path too long");
+		return 0;
+	}
+	sprintf(path, "%s/%s" CALIBSTORE_EXT, _calib_dir, name);
+
+	/* Load existing record, if compatible */
+	s->fd = fopen(path, "r+b");
+	if (s->fd) {
+		if (fread(header, sizeof(header), 1, s->fd) == 1 && header_matches(s, header)) {
+			memcpy(s->present, header + HEADER_PRESENT_OFFSET, sizeof(s->present));
+			log_debug("Loaded calibration record %s", path);
+			return 0;
+		}
+		fclose(s->fd);
+	}
+
+	/* Create new record */
+	s->fd = fopen(path, "w+b");
+	if (!s->fd) {
+		log_warn("Could not open calibration record %s", path);
+		return 0;
+	}
+	write_header(s);
+
+	return 0;
+}
+
+int
+calibstore_get(CalibStore *s, int seq, void *dst)
+{
+	if (!s->fd || seq < 0 || seq >= s->frag_count) return 1;
+	if (!(s->present[seq/8] & (1 << (seq%8)))) return 1;
+
+	if (fseek(s->fd, HEADER_LEN + (long)seq * s->frag_size, SEEK_SET)) return 1;
+	if (fread(dst, s->frag_size, 1, s->fd) != 1) return 1;
+
+	return 0;
+}
+
+void
+calibstore_put(CalibStore *s, int seq, const void *src)
+{
+	if (!s->fd || seq < 0 || seq >= s->frag_count) return;
+
+	if (fseek(s->fd, HEADER_LEN + (long)seq * s->frag_size, SEEK_SET)
+	 || fwrite(src, s->frag_size, 1, s->fd) != 1) {
+		log_warn("Error while writing calibration record");
+		return;
+	}
+
+	/* Mark fragment as present only after it has been written */
+	if (!(s->present[seq/8] & (1 << (seq%8)))) {
+		s->present[seq/8] |= 1 << (seq%8);
+		if (!fseek(s->fd, HEADER_PRESENT_OFFSET + seq/8, SEEK_SET)) {
+			fwrite(&s->present[seq/8], 1, 1, s->fd);
+		}
+	}
+
+	fflush(s->fd);
+}
+
+/* Static functions {{{ */
+static void
+write_header(CalibStore *s)
+{
+	uint8_t header[HEADER_LEN];
+
+	memcpy(header, CALIBSTORE_MAGIC, HEADER_VERSION_OFFSET);
+	header[HEADER_VERSION_OFFSET] = CALIBSTORE_VERSION;
+	header[HEADER_COUNT_OFFSET] = s->frag_count;
+	header[HEADER_SIZE_OFFSET] = s->frag_size & 0xFF;
+	header[HEADER_SIZE_OFFSET + 1] = s->frag_size >> 8;
+	memset(header + HEADER_PRESENT_OFFSET, 0, sizeof(s->present));
+
+	fwrite(header, sizeof(header), 1, s->fd);
+	fflush(s->fd);
+}
+
+static int
+header_matches(const CalibStore *s, const uint8_t *header)
+{
+	return !memcmp(header, CALIBSTORE_MAGIC, HEADER_VERSION_OFFSET)
+	    && header[HEADER_VERSION_OFFSET] == CALIBSTORE_VERSION
+	    && header[HEADER_COUNT_OFFSET] == s->frag_count
+	    && (header[HEADER_SIZE_OFFSET] | header[HEADER_SIZE_OFFSET + 1] << 8) == s->frag_size;
+}
+/* }}} */
@@ -0,0 +1,78 @@
+#ifndef calibstore_h
+#define calibstore_h
+
+/**
+ * Persistent per-serial calibration store. Each sonde gets a record file in
+ * the store directory, holding the calibration fragments received so far, so
+ * that a restarted decoder can produce calibrated data as soon as it sees the
+ * serial number of a known sonde.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define CALIBSTORE_MAX_FRAGS 64
+#define CALIBSTORE_SERIAL_LEN 32
+
+typedef struct {
+	FILE *fd;
+	char serial[CALIBSTORE_SERIAL_LEN];
+	int frag_size, frag_count;
+	uint8_t present[CALIBSTORE_MAX_FRAGS/8];
+} CalibStore;
+
+/**
+ * Set the directory calibration records are stored into. Stores opened before
+ * this is called, or after it's called with NULL, are not persisted.
+ *
+ * @param path directory to use
+ */
+void calibstore_set_dir(const char *path);
+
+/**
+ * Initialize a calibration store
+ *
+ * @param s store to initialize
+ * @param frag_size size of each calibration fragment, in bytes
+ * @param frag_count number of fragments, at most CALIBSTORE_MAX_FRAGS
+ */
+void calibstore_init(CalibStore *s, int frag_size, int frag_count);
+
+/**
+ * Close the record currently open, if any
+ *
+ * @param s store to close
+ */
+void calibstore_close(CalibStore *s);
+
+/**
+ * Switch to the record associated with the given serial number, creating it
+ * if necessary
+ *
+ * @param s store to use
+ * @param serial sonde serial number
+ * @return 0 if the serial number changed, and the caller should sync its
+ *         calibration data with the store, 1 otherwise
+ */
+int calibstore_open(CalibStore *s, const char *serial);
+
+/**
+ * Retrieve a fragment from the current record
+ *
+ * @param s store to read from
+ * @param seq fragment index
+ * @param dst buffer to write the fragment to, frag_size bytes long
+ * @return 0 on success, 1 if the fragment is not in the store
+ */
+int calibstore_get(CalibStore *s, int seq, void *dst);
+
+/**
+ * Write a fragment to the current record
+ *
+ * @param s store to write to
+ * @param seq fragment index
+ * @param src fragment to write, frag_size bytes long
+ */
+void calibstore_put(CalibStore *s, int seq, const void *src);
+
+#endif
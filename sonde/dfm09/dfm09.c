@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "bitops.h"
+#include "decode/accumulator.h"
 #include "decode/framer.h"
 #include "decode/manchester.h"
 #include "decode/correlator/correlator.h"
@@ -12,15 +13,21 @@
 #include "protocol.h"
 #include "parser.h"
 
+#define DFM09_SERIAL_SHARDS 4
+
 typedef struct {
 	DFM09Calib calib;
 	uint8_t ptu_serial_ch;
+	uint8_t serial_shards;      /* Bitmask of the serial shards received */
 	uint64_t raw_serial;
+	uint64_t last_serial;       /* Last serial number emitted */
 	struct tm time;
 } DFM09Data;
 
 static void dfm09_parse_ptu(SondeData *dst, DFM09Data *data, const DFM09Subframe_PTU *subframe);
 static void dfm09_parse_gps(SondeData *dst, DFM09Data *data, const DFM09Subframe_GPS *subframe);
+static int dfm09_frame_is_empty(const DFM09Frame *frame);
+static void format_serial(char *dst, uint64_t serial, int base, int min_digits);
 
 struct dfm09decoder {
 	Framer f;
@@ -29,6 +36,7 @@ struct dfm09decoder {
 	DFM09Frame parsed_frame;
 
 	SondeData partial_dst;
+	Accumulator acc;
 
 	DFM09Data data;
 };
@@ -46,6 +54,7 @@ dfm09_decoder_init(int samplerate)
 	framer_init_gfsk(&d->f, samplerate, DFM09_BAUDRATE, DFM09_FRAME_LEN, DFM09_SYNCWORD, DFM09_SYNC_LEN);
 	memset(&d->data, 0, sizeof(d->data));
 	d->partial_dst.fields = 0;
+	accumulator_init(&d->acc, DATA_SEQ | DATA_POS | DATA_SPEED | DATA_TIME);
 #ifndef NDEBUG
 	debug = fopen("/tmp/dfm09frames.data", "wb");
 #endif
@@ -71,7 +80,6 @@ dfm09_decode(DFM09Decoder *self, SondeData *dst, const float *src, size_t len)
 	DFM09Subframe_PTU *ptu = &self->parsed_frame.ptu;
 	DFM09Subframe_GPS *gps;
 	int i;
-	int valid;
 	int errcount;
 
 	/* Read a new frame */
@@ -88,24 +96,15 @@ dfm09_decode(DFM09Decoder *self, SondeData *dst, const float *src, size_t len)
 
 	dst->fields = 0;
 
-	/* Error correct, and exit prematurely if too many errors are found */
-	errcount = dfm09_frame_correct(self->frame);
+	/* Error correct and remove parity bits, exit prematurely if too many
+	 * errors are found */
+	errcount = dfm09_frame_correct(&self->parsed_frame, self->frame);
 	if (errcount < 0 || errcount > 8) {
 		return PARSED;
 	}
 
-	/* Remove parity bits */
-	dfm09_frame_unpack(&self->parsed_frame, self->frame);
-
 	/* If frame is all zeroes, discard and go to next */
-	valid = 0;
-	for (i=0; i<(int)sizeof(self->parsed_frame); i++) {
-		if (((uint8_t*)&self->parsed_frame)[i] != 0) {
-			valid = 1;
-			break;
-		}
-	}
-	if (!valid) return PARSED;
+	if (dfm09_frame_is_empty(&self->parsed_frame)) return PARSED;
 
 #ifndef NDEBUG
 	if (debug) fwrite((uint8_t*)&self->parsed_frame, sizeof(self->parsed_frame), 1, debug);
@@ -121,8 +120,9 @@ dfm09_decode(DFM09Decoder *self, SondeData *dst, const float *src, size_t len)
 	}
 
 	self->partial_dst.pressure = altitude_to_pressure(self->partial_dst.alt);
-	memcpy(dst, &self->partial_dst, sizeof(*dst));
-	self->partial_dst.fields = 0;
+
+	/* Output a record once a full set of fields has been received */
+	accumulator_push(&self->acc, dst, &self->partial_dst);
 
 	return PARSED;
 }
@@ -132,12 +132,11 @@ static void
 dfm09_parse_ptu(SondeData *dst, DFM09Data *data, const DFM09Subframe_PTU *subframe)
 {
 	uint32_t ch;
-	uint16_t serial_shard;
-	int serial_idx;
 	uint64_t local_serial;
+	int serial_idx, shards;
 
 	/* Get channel data as uint24_t */
-	ch = bitmerge(subframe->data, 24);
+	ch = (uint32_t)subframe->data[0] << 16 | subframe->data[1] << 8 | subframe->data[2];
 	data->calib.raw[subframe->type] = ch;
 
 	/* Last subframe before serial number is all zeroes */
@@ -151,41 +150,53 @@ dfm09_parse_ptu(SondeData *dst, DFM09Data *data, const DFM09Subframe_PTU *subfra
 		dst->temp = dfm09_temp(subframe, &data->calib);
 		dst->fields |= DATA_PTU;
 		dst->calib_percent = 100.0;
-		break;
+		return;
 	case DFM_SFTYPE_RH:
 		/* RH? */
 		dst->rh = 0;
-		break;
+		return;
 	default:
-		if (subframe->type == data->ptu_serial_ch) {
-			/* Serial number */
-
-			if (subframe->type == DFM06_SERIAL_TYPE) {
-				/* DFM06: direct serial number */
-				dst->fields |= DATA_SERIAL;
-				sprintf(dst->serial, "D%06X", ch);
-			} else {
-				/* DFM09: serial number spans multiple subframes */
-				serial_idx = 3 - (ch & 0xF);
-				serial_shard = (ch >> 4) & 0xFFFF;
-
-				/* Write 16 bit shard into the overall serial number */
-				data->raw_serial &= ~((uint64_t)((1 << 16) - 1) << (16*serial_idx));
-				data->raw_serial |= (uint64_t)serial_shard << (16*serial_idx);
-
-				/* If potentially complete, convert raw serial to string */
-				if ((ch & 0xF) == 0) {
-					local_serial = data->raw_serial;
-
-					while (local_serial && !(local_serial & 0xFFFF)) local_serial >>= 16;
-
-					dst->fields |= DATA_SERIAL;
-					sprintf(dst->serial, "D%08ld", local_serial);
-				}
-			}
-		}
 		break;
 	}
+
+	if (subframe->type != data->ptu_serial_ch) return;
+
+	/* Serial number: only converted to string when it changes */
+	if (subframe->type == DFM06_SERIAL_TYPE) {
+		/* DFM06: direct serial number */
+		if (ch == data->last_serial) return;
+		data->last_serial = ch;
+
+		dst->fields |= DATA_SERIAL;
+		format_serial(dst->serial, ch, 16, 6);
+		return;
+	}
+
+	/* DFM09: serial number spans multiple subframes, the last one being the
+	 * one with index 0 */
+	serial_idx = DFM09_SERIAL_SHARDS - 1 - (ch & 0xF);
+	if (serial_idx < 0) return;
+
+	/* Write 16 bit shard into the overall serial number */
+	data->raw_serial &= ~((uint64_t)0xFFFF << (16*serial_idx));
+	data->raw_serial |= (uint64_t)((ch >> 4) & 0xFFFF) << (16*serial_idx);
+	data->serial_shards |= 1 << serial_idx;
+
+	/* If potentially complete and different from the last one, convert raw
+	 * serial to string */
+	if ((ch & 0xF) != 0 || data->raw_serial == data->last_serial) return;
+	data->last_serial = data->raw_serial;
+
+	/* Skip the shards that are not in use by this model */
+	local_serial = data->raw_serial;
+	shards = data->serial_shards;
+	while (local_serial && (!(shards & 0x1) || !(local_serial & 0xFFFF))) {
+		local_serial >>= 16;
+		shards >>= 1;
+	}
+
+	dst->fields |= DATA_SERIAL;
+	format_serial(dst->serial, local_serial, 10, 8);
 }
 
 static void
@@ -234,4 +245,40 @@ dfm09_parse_gps(SondeData *dst, DFM09Data *data, const DFM09Subframe_GPS *subfra
 		break;
 	}
 }
+
+static int
+dfm09_frame_is_empty(const DFM09Frame *frame)
+{
+	const uint8_t *data = (const uint8_t*)frame;
+	size_t len = sizeof(*frame);
+	uint32_t word;
+
+	for (; len >= sizeof(word); len -= sizeof(word), data += sizeof(word)) {
+		memcpy(&word, data, sizeof(word));
+		if (word) return 0;
+	}
+	for (; len > 0; len--) {
+		if (*data++) return 0;
+	}
+
+	return 1;
+}
+
+static void
+format_serial(char *dst, uint64_t serial, int base, int min_digits)
+{
+	char digits[24];
+	int count;
+
+	count = 0;
+	do {
+		digits[count++] = "0123456789ABCDEF"[serial % base];
+		serial /= base;
+	} while (serial);
+	while (count < min_digits) digits[count++] = '0';
+
+	*dst++ = 'D';
+	while (count > 0) *dst++ = digits[--count];
+	*dst = 0;
+}
 /* }}} */
@@ -1,10 +1,10 @@
 #include <math.h>
 #include <string.h>
+#include "decode/ecc/tables.h"
 #include "frame.h"
 #include "utils.h"
 
-static int parity(uint8_t x);
-static int hamming(uint8_t *data, int len);
+static int hamming(uint8_t *dst, const uint8_t *src, int len);
 
 void
 dfm09_frame_deinterleave(DFM09ECCFrame *frame)
@@ -38,73 +38,53 @@ dfm09_frame_deinterleave(DFM09ECCFrame *frame)
 }
 
 int
-dfm09_frame_correct(DFM09ECCFrame *frame)
+dfm09_frame_correct(DFM09Frame *dst, const DFM09ECCFrame *src)
 {
+	uint8_t ptu[sizeof(src->ptu)], gps[sizeof(src->gps)];
 	int ptuErrcount, gpsErrcount;
+	int i;
 
-	ptuErrcount = hamming(frame->ptu, sizeof(frame->ptu));
-	gpsErrcount = hamming(frame->gps, sizeof(frame->gps));
+	/* Decode each codeword to its data nibble */
+	ptuErrcount = hamming(ptu, src->ptu, sizeof(ptu));
+	gpsErrcount = hamming(gps, src->gps, sizeof(gps));
 
 	if (ptuErrcount < 0 || gpsErrcount < 0) return -1;
 
-	return ptuErrcount + gpsErrcount;
-}
-
-void
-dfm09_frame_unpack(DFM09Frame *dst, const DFM09ECCFrame *src)
-{
-	int i;
-
-	dst->ptu.type = src->ptu[0] >> 4;
+	/* Merge nibbles back into bytes */
+	dst->ptu.type = ptu[0] >> 4;
 	for (i=0; i<(int)sizeof(dst->ptu.data); i++) {
-		dst->ptu.data[i] = (src->ptu[1+2*i] & 0xF0) | (src->ptu[1+2*i+1] >> 4);
+		dst->ptu.data[i] = ptu[1+2*i] | (ptu[1+2*i+1] >> 4);
 	}
 
-	dst->gps[0].type = src->gps[12] >> 4;
+	dst->gps[0].type = gps[12] >> 4;
 	for (i=0; i<(int)sizeof(dst->gps[0].data); i++) {
-		dst->gps[0].data[i] = (src->gps[2*i] & 0xF0) | (src->gps[2*i+1] >> 4);
+		dst->gps[0].data[i] = gps[2*i] | (gps[2*i+1] >> 4);
 	}
 
-	dst->gps[1].type = src->gps[25] >> 4;
+	dst->gps[1].type = gps[25] >> 4;
 	for (i=0; i<(int)sizeof(dst->gps[1].data); i++) {
-		dst->gps[1].data[i] = (src->gps[13+2*i] & 0xF0) | (src->gps[13+2*i+1] >> 4);
-	}
-}
-
-/* Static functions {{{ */
-static int
-parity(uint8_t x)
-{
-	int ret;
-
-	for (ret = 0; x; ret++) {
-		x &= x-1;
+		dst->gps[1].data[i] = gps[13+2*i] | (gps[13+2*i+1] >> 4);
 	}
 
-	return ret % 2;
+	return ptuErrcount + gpsErrcount;
 }
 
+/* Static functions {{{ */
 static int
-hamming(uint8_t *data, int len)
+hamming(uint8_t *dst, const uint8_t *src, int len)
 {
-	const uint8_t hamming_bitmasks[] = {0xaa, 0x66, 0x1e, 0xff};
-	int errpos, errcount = 0;
-	int i, j;
+	int errcount = 0;
+	uint8_t flags = 0;
+	int i;
 
+	/* No early exit, so that the loop stays branchless */
 	for (i=0; i<len; i++) {
-		errpos = 0;
-		for (j=0; j<(int)sizeof(hamming_bitmasks); j++) {
-			errpos += (1 << j) * parity(data[i] & hamming_bitmasks[j]);
-		}
-
-		if (errpos > 7) return -1;
-
-		if (errpos) {
-			errcount++;
-			data[i] ^= 1 << (8 - errpos);
-		}
+		dst[i] = dfm09_hamming_table[src[i]];
+		flags |= dst[i];
+		errcount += dst[i] & HAMMING_CORRECTED;
+		dst[i] &= 0xF0;
 	}
 
-	return errcount;
+	return flags & HAMMING_UNCORRECTABLE ? -1 : errcount;
 }
 /* }}} */
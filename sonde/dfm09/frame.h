@@ -11,19 +11,13 @@
 void dfm09_frame_deinterleave(DFM09ECCFrame *frame);
 
 /**
- * Perform error correction on the given frame
- *
- * @param frame frame to error correct
- * @return -1 if too many errors
- *         else number of errors corrected
- */
-int  dfm09_frame_correct(DFM09ECCFrame *frame);
-
-/**
- * Strip error-correcting bits from the given frame, reconstructing the payload
+ * Perform error correction on the given frame, stripping error-correcting bits
+ * and reconstructing the payload in the same pass
  *
  * @param dst destination buffer to write the compacted frame to
  * @param src source buffer containing the raw frame
+ * @return -1 if too many errors
+ *         else number of errors corrected
  */
-void dfm09_frame_unpack(DFM09Frame *dst, const DFM09ECCFrame *src);
+int  dfm09_frame_correct(DFM09Frame *dst, const DFM09ECCFrame *src);
 #endif
@@ -1,16 +1,14 @@
 #include <include/imet4.h>
 #include <math.h>
-#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include "bitops.h"
+#include "decode/accumulator.h"
 #include "decode/ecc/crc.h"
-#include "decode/framer.h"
-#include "decode/manchester.h"
-#include "frame.h"
+#include "demod/afsk.h"
 #include "gps/ecef.h"
 #include "log/log.h"
 #include "subframe.h"
@@ -18,16 +16,34 @@
 #include "physics.h"
 #include "parser.h"
 
+#define IMET4_BITBUF_LEN 8
 
+enum uart_state { UART_IDLE, UART_DATA, UART_STOP };
+
+static int uart_feed(IMET4Decoder *self, int bit);
+static int subframe_feed(IMET4Decoder *self, uint8_t byte);
+static void postprocess_subframe(IMET4Decoder *self, SondeData *dst);
 static uint16_t imet4_serial(int seq, time_t time);
 static void imet4_parse_subframe(SondeData *dst, IMET4Subframe *subframe);
 
 struct imet4decoder {
-	Framer f;
-	IMET4Frame raw_frame[2];
-	IMET4Frame frame;
-	uint32_t prev_time;
-	float prev_x, prev_y, prev_z;
+	AFSKDemod demod;
+	uint8_t bits[IMET4_BITBUF_LEN];
+	size_t bit_offset, bit_read;
+	int src_consumed;
+
+	enum uart_state uart_state;
+	int uart_bitcount;
+	uint8_t uart_byte;
+
+	IMET4Subframe subframe;
+	size_t subframe_offset, subframe_len;
+
+	int seq;
+	ENUVelocity velocity;
+
+	SondeData partial_dst;
+	Accumulator acc;
 };
 
 #ifndef NDEBUG
@@ -39,9 +55,16 @@ __global IMET4Decoder*
 imet4_decoder_init(int samplerate)
 {
 	IMET4Decoder *d = malloc(sizeof(*d));
-	framer_init_afsk(&d->f, samplerate, IMET4_BAUDRATE, IMET4_FRAME_LEN,
-			IMET4_MARK_FREQ, IMET4_SPACE_FREQ,
-			IMET4_SYNCWORD, IMET4_SYNC_LEN);
+
+	memset(d, 0, sizeof(*d));
+	if (afsk_init(&d->demod, samplerate, IMET4_BAUDRATE, IMET4_MARK_FREQ, IMET4_SPACE_FREQ)) {
+		free(d);
+		return NULL;
+	}
+	d->uart_state = UART_IDLE;
+	d->seq = -1;
+	enu_velocity_init(&d->velocity);
+	accumulator_init(&d->acc, DATA_PTU | DATA_POS | DATA_TIME);
 
 #ifndef NDEBUG
 	debug = fopen("/tmp/imet4frames.data", "wb");
@@ -52,7 +75,7 @@ imet4_decoder_init(int samplerate)
 
 __global void
 imet4_decoder_deinit(IMET4Decoder *d) {
-	framer_deinit(&d->f);
+	afsk_deinit(&d->demod);
 	free(d);
 
 #ifndef NDEBUG
@@ -64,87 +87,139 @@ imet4_decoder_deinit(IMET4Decoder *d) {
 __global ParserStatus
 imet4_decode(IMET4Decoder *self, SondeData *dst, const float *src, size_t len)
 {
-	float x, y, z, dt;
-	size_t i;
-	size_t bytes_consumed;
-	int subframe_len;
-
-	IMET4Subframe *subframe;
-
-	/* Read a new frame */
-	switch (framer_read(&self->f, self->raw_frame, src, len)) {
-	case PROCEED:
-		return PROCEED;
-	case PARSED:
-		break;
-	}
+	int bit, byte;
 
-	/* Reformat data inside the frame */
-	imet4_frame_descramble(&self->frame, self->raw_frame);
+	for (;;) {
+		/* Feed the bits demodulated so far to the UART, one at a time, and
+		 * return as soon as a full subframe is available */
+		while (self->bit_read < self->bit_offset) {
+			bit = (self->bits[self->bit_read/8] >> (7 - self->bit_read%8)) & 0x1;
+			self->bit_read++;
+
+			byte = uart_feed(self, bit);
+			if (byte < 0 || !subframe_feed(self, byte)) continue;
 
 #ifndef NDEBUG
-	if (debug) fwrite(&self->frame, sizeof(self->frame), 1, debug);
+			if (debug) fwrite(&self->subframe, self->subframe_len, 1, debug);
 #endif
+			log_debug("Type %d", self->subframe.type);
 
-	/* Prepare to parse subframes */
-	dst->fields = 0;
+			self->partial_dst.fields = 0;
+			imet4_parse_subframe(&self->partial_dst, &self->subframe);
+			postprocess_subframe(self, &self->partial_dst);
 
-	for (i = 0; i < sizeof(self->frame.data); i += subframe_len) {
-		/* Extract subframe */
-		subframe = (IMET4Subframe*)&self->frame.data[i];
-		subframe_len = imet4_subframe_len(subframe);
+			/* Subframes carry parts of the same observation: merge them */
+			accumulator_push(&self->acc, dst, &self->partial_dst);
 
-		/* If zero-length, stop parsing the entire frame */
-		if (!subframe_len) break;
+			return PARSED;
+		}
 
-		/* Verify CRC, and invalidate frame if it doesn't match */
-		if (!crc16_aug_ccitt((uint8_t*)subframe, subframe_len)) {
-			/* Parse subframe */
-			imet4_parse_subframe(dst, subframe);
-			log_debug("Type %d", subframe->type);
-		} else if (subframe->type == IMET4_SFTYPE_XDATA) {
-			/* Variable length packet corrupted: stop parsing */
-			break;
+		/* If the input buffer was already fully demodulated, ask for more */
+		if (self->src_consumed) {
+			self->src_consumed = 0;
+			return PROCEED;
+		}
+
+		/* Demodulate more bits, reusing the buffer once it's fully consumed */
+		if (self->bit_offset >= 8 * sizeof(self->bits)) {
+			self->bit_offset = self->bit_read = 0;
+		}
+		if (afsk_demod(&self->demod, self->bits, &self->bit_offset, 8 * sizeof(self->bits), src, len) == PROCEED) {
+			self->src_consumed = 1;
+		}
+	}
+}
+
+/* Static functions {{{ */
+static int
+uart_feed(IMET4Decoder *self, int bit)
+{
+	/* 8N1 framing: start bit (space), 8 data bits LSB first, stop bit (mark) */
+	switch (self->uart_state) {
+	case UART_IDLE:
+		if (!bit) {
+			self->uart_state = UART_DATA;
+			self->uart_bitcount = 0;
+			self->uart_byte = 0;
+		}
+		break;
+	case UART_DATA:
+		self->uart_byte |= bit << self->uart_bitcount;
+		if (++self->uart_bitcount == 8) self->uart_state = UART_STOP;
+		break;
+	case UART_STOP:
+		self->uart_state = UART_IDLE;
+		if (bit) return self->uart_byte;
+
+		/* Framing error: the subframe being assembled is missing a byte */
+		self->subframe_offset = 0;
+		self->seq = -1;
+		break;
+	}
+
+	return -1;
+}
+
+static int
+subframe_feed(IMET4Decoder *self, uint8_t byte)
+{
+	uint8_t *raw = (uint8_t*)&self->subframe;
+
+	/* Wait for start of header */
+	if (!self->subframe_offset && byte != IMET4_SUBFRAME_SOH) return 0;
+
+	raw[self->subframe_offset++] = byte;
+
+	/* Compute the subframe length as soon as enough of the header is in */
+	if (self->subframe_offset == IMET4_SUBFRAME_HEADER_LEN) {
+		self->subframe_len = imet4_subframe_len(&self->subframe);
+
+		if (!self->subframe_len || self->subframe_len > sizeof(self->subframe)) {
+			self->subframe_offset = 0;
+			return 0;
 		}
 	}
 
-	/* If anything was parsed, adjust the framer position by the actual number
-	 * of bits used */
-	if (i > 0) {
-		bytes_consumed = offsetof(IMET4Frame, data) + i;
-		framer_adjust(&self->f, self->raw_frame, 10 * bytes_consumed);  /* start + byte + stop */
-		log_debug("Adjusting by %u bytes", bytes_consumed);
+	if (self->subframe_offset < IMET4_SUBFRAME_HEADER_LEN
+	 || self->subframe_offset < self->subframe_len) {
+		return 0;
 	}
 
-	/* If speed data is missing, but both position and time data is available,
-	 * compute it based on the position difference */
-	if (!BITMASK_CHECK(dst->fields, DATA_SPEED) && BITMASK_CHECK(dst->fields, DATA_POS | DATA_TIME)) {
-		dst->fields |= DATA_SPEED;
+	/* Subframe complete: verify CRC */
+	self->subframe_offset = 0;
+	if (crc16_aug_ccitt(raw, self->subframe_len)) {
+		log_debug("CRC mismatch, type %d", self->subframe.type);
+		self->seq = -1;
+		return 0;
+	}
 
-		/* Convert to ECEF coordinates to estimate speed vector */
-		dt = dst->time - self->prev_time;
-		lla_to_ecef(&x, &y, &z, dst->lat, dst->lon, dst->alt);
-		ecef_to_spd_hdg(&dst->speed, &dst->heading, &dst->climb,
-						dst->lat, dst->lon,
-						(x - self->prev_x)/dt, (y - self->prev_y)/dt, (z - self->prev_z)/dt);
-
-		/* Update last known x/y/z */
-		self->prev_x = x;
-		self->prev_y = y;
-		self->prev_z = z;
-		self->prev_time = dst->time;
+	return 1;
+}
+
+static void
+postprocess_subframe(IMET4Decoder *self, SondeData *dst)
+{
+	/* If speed data is missing, but both position and time data is
+	 * available, compute it based on the position difference */
+	if (!BITMASK_CHECK(dst->fields, DATA_SPEED) && BITMASK_CHECK(dst->fields, DATA_POS | DATA_TIME)) {
+		if (!enu_velocity_update(&self->velocity, &dst->speed, &dst->heading, &dst->climb,
+		                         dst->lat, dst->lon, dst->alt, dst->time)) {
+			dst->fields |= DATA_SPEED;
+		}
 	}
 
-	/* Derive serial number from est. turn-on time */
-	if (BITMASK_CHECK(dst->fields, DATA_SEQ | DATA_TIME)) {
+	/* Derive serial number from est. turn-on time. Sequence number and time
+	 * come from different subframes: only pair them if they belong to the
+	 * same burst, i.e. if no subframe was lost in between. Any mismatch would
+	 * produce a completely different serial number */
+	if (BITMASK_CHECK(dst->fields, DATA_SEQ)) self->seq = dst->seq;
+	if (BITMASK_CHECK(dst->fields, DATA_TIME) && self->seq >= 0) {
 		dst->fields |= DATA_SERIAL;
-		sprintf(dst->serial, "iMet-%04X", imet4_serial(dst->seq, dst->time));
+		sprintf(dst->serial, "iMet-%04X", imet4_serial(self->seq, dst->time));
+		self->seq = -1;
 	}
-
-	return PARSED;
 }
 
-/* Static functions {{{ */
 static uint16_t
 imet4_serial(int seq, time_t time)
 {
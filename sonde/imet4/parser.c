@@ -45,12 +45,12 @@ imet4_gps_time(const IMET4Subframe_GPS *gps)
 
 	/* Date is not transmitted: use current date */
 	now = time(NULL);
-	datetime = *gmtime(&now);
+	my_gmtime_r(&now, &datetime);
 
 	/* Handle 0Z crossing */
 	if (abs(gps->hour - datetime.tm_hour) >= 12) {
 		now += (gps->hour < datetime.tm_hour) ? 86400 : -86400;
-		datetime = *gmtime(&now);
+		my_gmtime_r(&now, &datetime);
 	}
 
 	datetime.tm_hour = gps->hour;
@@ -68,12 +68,12 @@ imet4_gpsx_time(const IMET4Subframe_GPSX *gps)
 
 	/* Date is not transmitted: use current date */
 	now = time(NULL);
-	datetime = *gmtime(&now);
+	my_gmtime_r(&now, &datetime);
 
 	/* Handle 0Z crossing */
 	if (abs(gps->hour - datetime.tm_hour) >= 12) {
 		now += (gps->hour < datetime.tm_hour) ? 86400 : -86400;
-		datetime = *gmtime(&now);
+		my_gmtime_r(&now, &datetime);
 	}
 
 	datetime.tm_hour = gps->hour;
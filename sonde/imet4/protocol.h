@@ -5,12 +5,12 @@
 #include "utils.h"
 
 #define IMET4_BAUDRATE 1200
-#define IMET4_SYNCWORD 0xFF40
-#define IMET4_SYNC_LEN 16
 #define IMET4_MARK_FREQ 2200.0
 #define IMET4_SPACE_FREQ 1200.0
 
 #define IMET4_FRAME_LEN 600
+#define IMET4_SUBFRAME_SOH 0x01
+#define IMET4_SUBFRAME_HEADER_LEN 3    /* soh + type + XDATA length */
 
 
 enum imet4_sftype {
@@ -26,11 +26,6 @@ enum imet4_xdata_instr {
 	IMET4_XDATA_INSTR_HYGRO = 0x10,
 };
 
-PACK(typedef struct {
-	uint8_t sync[1];
-	uint8_t data[IMET4_FRAME_LEN/8 - 3];
-}) IMET4Frame;
-
 PACK(typedef struct {
 	uint8_t soh;
 	uint8_t type;
@@ -8,7 +8,7 @@ size_t
 imet4_subframe_len(IMET4Subframe *sf)
 {
 	/* If start of header is missing, discard frame */
-	if (sf->soh != 0x01) return 0;
+	if (sf->soh != IMET4_SUBFRAME_SOH) return 0;
 
 	switch (sf->type) {
 	case IMET4_SFTYPE_PTU:
@@ -2,12 +2,19 @@
 #include <string.h>
 #include <time.h>
 #include "bitops.h"
+#include "decode/ecc/tables.h"
 #include "frame.h"
 #include "utils.h"
 #include "log/log.h"
 
+#define IMS100_BCH_MAX_ERASURES 4   /* Minimum distance - 1 */
+
+static uint64_t bch_read_message(const void *src, int offset);
+static int bch_correct(uint64_t *message);
+static int count_bits(uint64_t x);
+
 void
-ims100_frame_descramble(IMS100ECCFrame *frame)
+ims100_frame_descramble(IMS100ECCFrame *frame, uint8_t *erasures)
 {
 	int i;
 	uint8_t *raw_frame = (uint8_t*)frame;
@@ -15,23 +22,26 @@ ims100_frame_descramble(IMS100ECCFrame *frame)
 	for (i=0; i<(int)sizeof(*frame); i++) {
 		raw_frame[i] ^= raw_frame[i] << 1 | raw_frame[i+1] >> 7;
 	}
+
+	/* Each output bit depends on two input bits: if either is unreliable, so
+	 * is the result */
+	if (erasures) {
+		for (i=0; i<(int)sizeof(*frame); i++) {
+			erasures[i] |= erasures[i] << 1 | erasures[i+1] >> 7;
+		}
+	}
 }
 
 int
-ims100_frame_error_correct(IMS100ECCFrame *frame, const RSDecoder *rs)
+ims100_frame_error_correct(IMS100ECCFrame *frame, const uint8_t *erasures)
 {
-	const int start_idx = IMS100_REEDSOLOMON_N - IMS100_MESSAGE_LEN;
+	uint8_t *raw_frame = (uint8_t*)frame;
 	int i, j, k;
-	int offset;
+	int offset, pos;
 	int errcount, errdelta;
-	uint8_t staging[IMS100_MESSAGE_LEN/8+1];
-	/* FIXME this should not need the +1, but Windows compiled versions get
-	 * angry because of some buffer overflow. Check BCH code, one of the roots
-	 * can be 63 which is past the end of buffer */
-	uint8_t message[IMS100_REEDSOLOMON_N + 1];
+	uint64_t message, corrected, mask, tmp;
 
 	errcount = 0;
-	memset(message, 0, sizeof(message));
 
 	/* For each subframe within the frame */
 	for (i=0; i < 8 * (int)sizeof(*frame); i += IMS100_SUBFRAME_LEN) {
@@ -39,27 +49,41 @@ ims100_frame_error_correct(IMS100ECCFrame *frame, const RSDecoder *rs)
 		for (j=8*sizeof(frame->syncword); j < IMS100_SUBFRAME_LEN; j += IMS100_MESSAGE_LEN) {
 			offset = i + j;
 
-			bitcpy(staging, frame, offset, IMS100_MESSAGE_LEN);
-
-			/* Expand bits to bytes, zero-padding to a (64,51) code */
-			for (k=0; k<IMS100_MESSAGE_LEN; k++) {
-				message[start_idx + k] = (staging[k/8] >> (7 - k%8)) & 0x1;
-			}
-
-			/* Error correct */
-			errdelta = rs_fix_block(rs, message);
-			if (errdelta < 0 || errcount < 0) {
-				errcount = -1;
+			message = corrected = bch_read_message(frame, offset);
+			mask = erasures ? bch_read_message(erasures, offset) : 0;
+
+			if (mask && count_bits(mask) <= IMS100_BCH_MAX_ERASURES) {
+				/* Some bits were received unreliably: decode assuming they are
+				 * all zeroes, then all ones. With e erasures and v errors, one
+				 * of the two has at most v + e/2 errors. If both decode, keep
+				 * the one that changes fewer reliable bits */
+				corrected = message & ~mask;
+				errdelta = bch_correct(&corrected);
+
+				tmp = message | mask;
+				if (bch_correct(&tmp) >= 0
+				 && (errdelta < 0 || count_bits((tmp ^ message) & ~mask) < count_bits((corrected ^ message) & ~mask))) {
+					corrected = tmp;
+					errdelta = 0;
+				}
 			} else {
-				errcount += errdelta;
+				errdelta = bch_correct(&corrected);
 			}
 
 			if (errdelta < 0) {
 				/* If ECC fails, clear the message */
 				bitclear(frame, offset, 2 * IMS100_SUBFRAME_VALUELEN);
-			} else if (errdelta) {
-				/* Else, copy corrected bits back */
-				bitpack(frame, message + start_idx, offset, IMS100_MESSAGE_LEN);
+				errcount = -1;
+				continue;
+			}
+
+			/* Flip the erroneous bits in place */
+			for (k=0, tmp = corrected ^ message; tmp; k++, tmp >>= 1) {
+				if (tmp & 0x1) {
+					pos = offset + IMS100_MESSAGE_LEN - 1 - k;
+					raw_frame[pos/8] ^= 0x80 >> (pos%8);
+					if (errcount >= 0) errcount++;
+				}
 			}
 		}
 	}
@@ -111,3 +135,56 @@ ims100_frame_unpack(IMS100Frame *frame, const IMS100ECCFrame *ecc_frame)
 	}
 }
 
+/* Static functions {{{ */
+static uint64_t
+bch_read_message(const void *src, int offset)
+{
+	uint8_t staging[IMS100_BCH_SYNDROME_BYTES];
+	uint64_t message;
+	int i;
+
+	/* Pack message into a word, first bit transmitted in bit 45 */
+	bitcpy(staging, src, offset, IMS100_MESSAGE_LEN);
+	message = 0;
+	for (i=0; i<(int)sizeof(staging); i++) {
+		message = message << 8 | staging[i];
+	}
+
+	return message >> (8 * sizeof(staging) - IMS100_MESSAGE_LEN);
+}
+
+static int
+bch_correct(uint64_t *message)
+{
+	uint16_t syndrome, error;
+	int i;
+
+	/* Compute syndrome, one byte at a time */
+	syndrome = 0;
+	for (i=0; i<IMS100_BCH_SYNDROME_BYTES; i++) {
+		syndrome ^= ims100_bch_syndrome_table[i][(*message >> (8*i)) & 0xFF];
+	}
+	if (!syndrome) return 0;
+
+	error = ims100_bch_error_table[syndrome];
+	if (!error) return -1;
+
+	for (i=0; i < error >> 12; i++) {
+		*message ^= 1ULL << ((error >> (6*i)) & 0x3F);
+	}
+
+	return error >> 12;
+}
+
+static int
+count_bits(uint64_t x)
+{
+	int count;
+
+	for (count=0; x; count++) {
+		x &= x - 1;
+	}
+
+	return count;
+}
+/* }}} */
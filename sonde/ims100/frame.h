@@ -1,25 +1,29 @@
 #ifndef ims100_frame_h
 #define ims100_frame_h
 
-#include "decode/ecc/rs.h"
 #include "protocol.h"
 
 /**
  * Reorder bits within the frame so that they make sense
  *
  * @param frame frame to descramble
+ * @param erasures optional bitmap of unreliable bits, parallel to the frame.
+ *        Updated to account for the descrambler spreading them. Can be NULL
  */
-void ims100_frame_descramble(IMS100ECCFrame *frame);
+void ims100_frame_descramble(IMS100ECCFrame *frame, uint8_t *erasures);
 
 /**
  * Perform error correction on the frame
  *
  * @param frame frame to correct
- * @param rs Reed-Solomon decoder to use
+ * @param erasures optional bitmap of unreliable bits, parallel to the frame.
+ *        Messages with at most 4 such bits are decoded twice, with all of
+ *        them set to 0 and then to 1, keeping the result that changes fewer
+ *        reliable bits. Can be NULL
  * @return -1 if uncorrectable errors were detected
  *         number of errors corrected otherwise
  */
-int ims100_frame_error_correct(IMS100ECCFrame *frame, const RSDecoder *rs);
+int ims100_frame_error_correct(IMS100ECCFrame *frame, const uint8_t *erasures);
 
 /**
  * Strip error-correcting bits from the given frame, reconstructing the payload
@@ -8,6 +8,7 @@
 #include "frame.h"
 #include "protocol.h"
 #include "parser.h"
+#include "sonde/calibstore.h"
 #include "utils.h"
 #include "log/log.h"
 
@@ -20,11 +21,13 @@ static void rs11g_parse_frame(IMS100Decoder *self, SondeData *dst);
 
 static void ims100_update_calibration(IMS100Decoder *self, int seq, const uint8_t *fragment);
 static void rs11g_update_calibration(IMS100Decoder *self, int seq, const uint8_t *fragment);
+static void update_calibration_fragment(IMS100Decoder *self, int offset, const void *fragment);
+static void sync_calibration_store(IMS100Decoder *self, const char *serial);
 
 struct ims100decoder {
 	Framer f;
-	RSDecoder rs;
 	IMS100ECCFrame raw_frame[4];
+	uint8_t erasures[sizeof(IMS100ECCFrame) + 1];   /* Manchester violations */
 	IMS100ECCFrame ecc_frame;
 	IMS100Frame frame;
 
@@ -34,6 +37,9 @@ struct ims100decoder {
 	} calib;
 
 	uint64_t calib_bitmask;
+	CalibStore store;
+	CSpline temp_spline;
+	int temp_spline_subtype;    /* Subtype the spline was built for, -1 if stale */
 	time_t date;
 
 	struct {
@@ -50,10 +56,10 @@ ims100_decoder_init(int samplerate)
 	IMS100Decoder *d = malloc(sizeof(*d));
 
 	framer_init_gfsk(&d->f, samplerate, IMS100_BAUDRATE, IMS100_FRAME_LEN, IMS100_SYNCWORD, IMS100_SYNC_LEN);
-	bch_init(&d->rs, IMS100_REEDSOLOMON_N, IMS100_REEDSOLOMON_K,
-			IMS100_REEDSOLOMON_POLY, ims100_bch_roots, IMS100_REEDSOLOMON_T);
 
 	d->calib_bitmask = 0;
+	d->temp_spline_subtype = -1;
+	calibstore_init(&d->store, IMS100_CALIB_FRAGSIZE, IMS100_CALIB_FRAGCOUNT);
 	d->prev_alt.alt = 0;
 	d->prev_alt.time = -1UL;
 	d->date = 0;
@@ -69,7 +75,7 @@ __global void
 ims100_decoder_deinit(IMS100Decoder *d)
 {
 	framer_deinit(&d->f);
-	rs_deinit(&d->rs);
+	calibstore_close(&d->store);
 	free(d);
 #ifndef NDEBUG
 	if (debug) fclose(debug);
@@ -91,14 +97,14 @@ ims100_decode(IMS100Decoder *self, SondeData *dst, const float *src, size_t len)
 	}
 
 	/* Decode bits and move them in the right place */
-	manchester_decode(&self->ecc_frame, self->raw_frame, IMS100_FRAME_LEN);
-	ims100_frame_descramble(&self->ecc_frame);
+	manchester_decode_violations(&self->ecc_frame, self->erasures, self->raw_frame, IMS100_FRAME_LEN);
+	ims100_frame_descramble(&self->ecc_frame, self->erasures);
 
 	/* Prepare for subframe parsing */
 	dst->fields = 0;
 
 	/* Error correct and remove all ECC bits */
-	errcount = ims100_frame_error_correct(&self->ecc_frame, &self->rs);
+	errcount = ims100_frame_error_correct(&self->ecc_frame, self->erasures);
 	if (errcount < 0) {
 		/* ECC failed: go to next frame */
 		return PARSED;
@@ -166,9 +172,14 @@ ims100_parse_frame(IMS100Decoder *self, SondeData *dst)
 			break;
 		}
 
+		if (self->temp_spline_subtype != SUBTYPE_IMS100) {
+			ims100_temp_spline(&self->temp_spline, &self->calib.ims100);
+			self->temp_spline_subtype = SUBTYPE_IMS100;
+		}
+
 		dst->fields |= DATA_PTU;
-		dst->temp = ims100_temp(&self->adc, &self->calib.ims100);
-		dst->rh = ims100_rh(&self->adc, &self->calib.ims100);
+		dst->temp = ims100_temp(&self->adc, &self->calib.ims100, &self->temp_spline);
+		dst->rh = ims100_rh(&self->adc, &self->calib.ims100, &self->temp_spline);
 		dst->pressure = 0;
 		dst->calib_percent = 100.0 * count_ones((uint8_t*)&self->calib_bitmask,
 		                                        sizeof(self->calib_bitmask))
@@ -266,9 +277,14 @@ rs11g_parse_frame(IMS100Decoder *self, SondeData *dst)
 		self->adc.temp = (uint16_t)self->frame.adc_val1[0] << 8 | self->frame.adc_val1[1];
 		self->adc.rh = (uint16_t)self->frame.adc_val2[0] << 8 | self->frame.adc_val2[1];
 
+		if (self->temp_spline_subtype != SUBTYPE_RS11G) {
+			rs11g_temp_spline(&self->temp_spline, &self->calib.rs11g);
+			self->temp_spline_subtype = SUBTYPE_RS11G;
+		}
+
 		dst->fields |= DATA_PTU;
-		dst->temp = rs11g_temp(&self->adc, &self->calib.rs11g);
-		dst->rh = rs11g_rh(&self->adc, &self->calib.rs11g);
+		dst->temp = rs11g_temp(&self->adc, &self->calib.rs11g, &self->temp_spline);
+		dst->rh = rs11g_rh(&self->adc, &self->calib.rs11g, &self->temp_spline);
 		dst->pressure = 0;
 		dst->calib_percent = 100.0 * count_ones((uint8_t*)&self->calib_bitmask,
 		                                        sizeof(self->calib_bitmask))
@@ -328,10 +344,14 @@ ims100_update_calibration(IMS100Decoder *self, int seq, const uint8_t *fragment)
 	const int calib_offset = seq % IMS100_CALIB_FRAGCOUNT;
 	const uint8_t raw[] = {fragment[2], fragment[3], fragment[0], fragment[1]};
 	const float coeff = ieee754_be(raw);
+	char serial[CALIBSTORE_SERIAL_LEN];
 
-	memcpy(((uint8_t*)&self->calib.ims100) + IMS100_CALIB_FRAGSIZE * calib_offset, &coeff, sizeof(coeff));
+	update_calibration_fragment(self, calib_offset, &coeff);
 
-	self->calib_bitmask |= (1ULL << (63 - calib_offset));
+	if (BITMASK_CHECK(self->calib_bitmask, IMS100_CALIB_SERIAL_MASK)) {
+		sprintf(serial, "IMS%d", (int)self->calib.ims100.serial);
+		sync_calibration_store(self, serial);
+	}
 }
 
 static void
@@ -339,9 +359,55 @@ rs11g_update_calibration(IMS100Decoder *self, int seq, const uint8_t *fragment)
 {
 	const int calib_offset = seq % IMS100_CALIB_FRAGCOUNT;
 	const float coeff = mbf_le(fragment);
+	char serial[CALIBSTORE_SERIAL_LEN];
 
-	memcpy(((uint8_t*)&self->calib.rs11g) + IMS100_CALIB_FRAGSIZE * calib_offset, &coeff, sizeof(coeff));
+	update_calibration_fragment(self, calib_offset, &coeff);
 
-	self->calib_bitmask |= (1ULL << (63 - calib_offset));
+	if (BITMASK_CHECK(self->calib_bitmask, IMS100_CALIB_SERIAL_MASK)) {
+		sprintf(serial, "RS11G-%d", (int)self->calib.rs11g.serial);
+		sync_calibration_store(self, serial);
+	}
+}
+
+static void
+update_calibration_fragment(IMS100Decoder *self, int offset, const void *fragment)
+{
+	uint8_t *dst = (uint8_t*)&self->calib + IMS100_CALIB_FRAGSIZE * offset;
+	const uint64_t mask = 1ULL << (63 - offset);
+
+	if (!(self->calib_bitmask & mask) || memcmp(dst, fragment, IMS100_CALIB_FRAGSIZE)) {
+		memcpy(dst, fragment, IMS100_CALIB_FRAGSIZE);
+		self->calib_bitmask |= mask;
+		self->temp_spline_subtype = -1;
+		calibstore_put(&self->store, offset, fragment);
+	}
+}
+
+static void
+sync_calibration_store(IMS100Decoder *self, const char *serial)
+{
+	const int had_serial = self->store.serial[0];
+	uint8_t *fragment;
+	uint64_t mask;
+	int i;
+
+	if (calibstore_open(&self->store, serial)) return;
+
+	/* If the serial changed, all calibration data except for the serial
+	 * number itself belongs to another sonde */
+	if (had_serial) self->calib_bitmask &= IMS100_CALIB_SERIAL_MASK;
+
+	/* Save the fragments the store is missing, load the ones we are missing */
+	for (i=0; i<IMS100_CALIB_FRAGCOUNT; i++) {
+		fragment = (uint8_t*)&self->calib + IMS100_CALIB_FRAGSIZE * i;
+		mask = 1ULL << (63 - i);
+
+		if (self->calib_bitmask & mask) {
+			calibstore_put(&self->store, i, fragment);
+		} else if (!calibstore_get(&self->store, i, fragment)) {
+			self->calib_bitmask |= mask;
+			self->temp_spline_subtype = -1;
+		}
+	}
 }
 /* }}} */
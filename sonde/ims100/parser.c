@@ -1,7 +1,8 @@
 #include "parser.h"
 #include "physics.h"
 
-static float freq_to_temp(float temp_freq, float ref_freq, const float poly_coeffs[4], const float *spline_resists, const float *spline_temps, size_t spline_len);
+static float freq_to_temp(float temp_freq, float ref_freq, const float poly_coeffs[4], const CSpline *temp_spline);
+static void temp_spline_init(CSpline *dst, const float *spline_resists, const float *spline_temps, int spline_len);
 static float freq_to_rh_temp(float temp_rh_freq, float ref_freq, const float poly_coeffs[4], const float r_to_t_coeffs[3]);
 static float freq_to_rh(float rh_freq, float ref_freq, const float poly_coeffs[4]);
 
@@ -24,7 +25,7 @@ ims100_time(const IMS100FrameGPS *frame)
 	int year_unit;
 
 	now = time(NULL);
-	tm = *gmtime(&now);
+	my_gmtime_r(&now, &tm);
 
 	year_unit = tm.tm_year % 10;
 	tm.tm_year -= year_unit;
@@ -92,8 +93,14 @@ ims100_heading(const IMS100FrameGPS *frame)
 	return abs(raw_heading) / 1e2;
 }
 
+void
+ims100_temp_spline(CSpline *dst, const IMS100Calibration *calib)
+{
+	temp_spline_init(dst, calib->temp_resists, calib->temps, LEN(calib->temps));
+}
+
 float
-ims100_temp(const IMS100FrameADC *adc, const IMS100Calibration *calib)
+ims100_temp(const IMS100FrameADC *adc, const IMS100Calibration *calib, const CSpline *temp_spline)
 {
 	float temp_poly[4];
 
@@ -103,12 +110,11 @@ ims100_temp(const IMS100FrameADC *adc, const IMS100Calibration *calib)
 	temp_poly[2] = calib->temp_poly[2];
 	temp_poly[3] = 0;
 
-	return 1 + freq_to_temp(adc->temp, adc->ref,
-	                        temp_poly, calib->temp_resists, calib->temps, LEN(calib->temps));
+	return 1 + freq_to_temp(adc->temp, adc->ref, temp_poly, temp_spline);
 }
 
 float
-ims100_rh(const IMS100FrameADC *adc, const IMS100Calibration *calib)
+ims100_rh(const IMS100FrameADC *adc, const IMS100Calibration *calib, const CSpline *temp_spline)
 {
 	float air_temp, rh_temp, rh;
 	float temp_poly[4];
@@ -119,7 +125,7 @@ ims100_rh(const IMS100FrameADC *adc, const IMS100Calibration *calib)
 	temp_poly[2] = calib->temp_poly[2];
 	temp_poly[3] = 0;
 
-	air_temp = ims100_temp(adc, calib);
+	air_temp = ims100_temp(adc, calib, temp_spline);
 	rh_temp = 1 + freq_to_rh_temp(adc->rh_temp, adc->ref, temp_poly, calib->rh_temp_poly);
 	rh = freq_to_rh(adc->rh, adc->ref, calib->rh_poly);
 
@@ -225,15 +231,20 @@ rs11g_time(const RS11GFrameGPSRaw *frame)
 	return tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
 }
 
+void
+rs11g_temp_spline(CSpline *dst, const RS11GCalibration *calib)
+{
+	temp_spline_init(dst, calib->temp_resists, calib->temps, LEN(calib->temps));
+}
+
 float
-rs11g_temp(const IMS100FrameADC *adc, const RS11GCalibration *calib)
+rs11g_temp(const IMS100FrameADC *adc, const RS11GCalibration *calib, const CSpline *temp_spline)
 {
-	return freq_to_temp(adc->temp, adc->ref,
-	                    calib->temp_poly, calib->temp_resists, calib->temps, LEN(calib->temps));
+	return freq_to_temp(adc->temp, adc->ref, calib->temp_poly, temp_spline);
 }
 
 float
-rs11g_rh(const IMS100FrameADC *adc, const RS11GCalibration *calib)
+rs11g_rh(const IMS100FrameADC *adc, const RS11GCalibration *calib, const CSpline *temp_spline)
 {
 	/* K0..K6 in the GRUAN docs, found by fitting polynomials to the graphs shown.*/
 	const float temp_rh_coeffs[] = {5.79231318e-02, -2.64030081e-03, -1.32089353e-05, 7.15251769e-07,
@@ -241,7 +252,7 @@ rs11g_rh(const IMS100FrameADC *adc, const RS11GCalibration *calib)
 
 	float air_temp, rh, rh_cal, temp_correction;
 
-	air_temp = rs11g_temp(adc, calib);
+	air_temp = rs11g_temp(adc, calib, temp_spline);
 	rh = freq_to_rh(adc->rh, adc->ref, calib->rh_poly);
 
 	/* RS-11G specific temp correction, assuming that air and sensor temp are
@@ -261,11 +272,9 @@ rs11g_rh(const IMS100FrameADC *adc, const RS11GCalibration *calib)
 
 /* Static functions {{{ */
 static float
-freq_to_temp(float temp_freq, float ref_freq, const float poly_coeffs[4], const float *spline_resists, const float *spline_temps, size_t spline_len)
+freq_to_temp(float temp_freq, float ref_freq, const float poly_coeffs[4], const CSpline *temp_spline)
 {
 	float f_corrected, r_value, x, t_value;
-	float log_resists[12];
-	size_t i;
 
 	f_corrected = 4.0 * temp_freq / ref_freq;
 	x = 1.0 / (f_corrected - 1.0);
@@ -275,13 +284,22 @@ freq_to_temp(float temp_freq, float ref_freq, const float poly_coeffs[4], const
 	        + poly_coeffs[2] * x * x
 	        + poly_coeffs[3] * x * x * x;
 
-	/* Convert resistance values to their natural log, then interpolate the temp */
+	t_value = cspline_eval(temp_spline, logf(r_value));
+	return MAX(-100, MIN(100, t_value));
+}
+
+static void
+temp_spline_init(CSpline *dst, const float *spline_resists, const float *spline_temps, int spline_len)
+{
+	float log_resists[CSPLINE_MAX_KNOTS];
+	int i;
+
+	/* Interpolate temperature over the natural log of the resistance */
 	for (i=0; i<spline_len; i++) {
 		log_resists[i] = logf(spline_resists[i]);
 	}
 
-	t_value = cspline(log_resists, spline_temps, spline_len, logf(r_value));
-	return MAX(-100, MIN(100, t_value));
+	cspline_init(dst, log_resists, spline_temps, spline_len);
 }
 
 static float
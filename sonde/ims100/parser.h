@@ -1,6 +1,7 @@
 #ifndef ims100_parser_h
 #define ims100_parser_h
 #include "protocol.h"
+#include "utils.h"
 
 typedef struct {
 	uint16_t ref, temp, rh, rh_temp;
@@ -17,8 +18,16 @@ float ims100_alt(const IMS100FrameGPS *frame);
 float ims100_speed(const IMS100FrameGPS *frame);
 float ims100_heading(const IMS100FrameGPS *frame);
 
-float ims100_temp(const IMS100FrameADC *adc, const IMS100Calibration *calib);
-float ims100_rh(const IMS100FrameADC *adc, const IMS100Calibration *calib);
+/**
+ * Build the resistance to temperature spline from the calibration data
+ *
+ * @param dst spline to initialize
+ * @param calib calibration data
+ */
+void ims100_temp_spline(CSpline *dst, const IMS100Calibration *calib);
+
+float ims100_temp(const IMS100FrameADC *adc, const IMS100Calibration *calib, const CSpline *temp_spline);
+float ims100_rh(const IMS100FrameADC *adc, const IMS100Calibration *calib, const CSpline *temp_spline);
 
 time_t rs11g_date(const RS11GFrameGPS *frame);
 float rs11g_lat(const RS11GFrameGPS *frame);
@@ -30,8 +39,16 @@ float rs11g_climb(const RS11GFrameGPS *frame);
 
 time_t rs11g_time(const RS11GFrameGPSRaw *frame);
 
-float rs11g_temp(const IMS100FrameADC *adc, const RS11GCalibration *calib);
-float rs11g_rh(const IMS100FrameADC *adc, const RS11GCalibration *calib);
+/**
+ * Build the resistance to temperature spline from the calibration data
+ *
+ * @param dst spline to initialize
+ * @param calib calibration data
+ */
+void rs11g_temp_spline(CSpline *dst, const RS11GCalibration *calib);
+
+float rs11g_temp(const IMS100FrameADC *adc, const RS11GCalibration *calib, const CSpline *temp_spline);
+float rs11g_rh(const IMS100FrameADC *adc, const RS11GCalibration *calib, const CSpline *temp_spline);
 
 
 #endif
@@ -59,8 +59,6 @@
 #define IMS100_CALIB_FRAGSIZE 4
 #define IMS100_CALIB_FRAGCOUNT 64
 
-static const uint8_t ims100_bch_roots[] = {0x02, 0x04, 0x08, 0x10};
-
 /* IMS-100 subframe types {{{ */
 PACK(typedef struct {
 	uint8_t _pad0[2];
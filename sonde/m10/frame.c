@@ -1,8 +1,8 @@
+#include <stddef.h>
 #include <stdint.h>
+#include "decode/ecc/tables.h"
 #include "frame.h"
 
-static uint16_t m10_crc_step(uint16_t state, uint8_t data);
-
 void
 m10_frame_descramble(M10Frame *frame)
 {
@@ -23,32 +23,22 @@ m10_frame_correct(M10Frame *frame)
 {
 	const uint8_t *raw_frame = (uint8_t*)&frame->len;
 	const uint8_t *crc_ptr = (uint8_t*)&frame->len + frame->len - 1;
-	const uint16_t expected = crc_ptr[0] << 8 | crc_ptr[1];
+	uint16_t expected;
 	uint16_t crc;
 
+	/* Reject lengths that would make the checksum fall outside the frame */
+	if (frame->len < 2 || frame->len >= sizeof(*frame) - offsetof(M10Frame, len)) {
+		return -1;
+	}
+	expected = crc_ptr[0] << 8 | crc_ptr[1];
+
 	crc = 0;
 	for (; raw_frame < crc_ptr; raw_frame++) {
-		crc = m10_crc_step(crc, *raw_frame);
+		crc = (crc & 0xFF) << 8
+		    | (m10_checksum_data_table[*raw_frame]
+		     ^ m10_checksum_lo_table[crc & 0xFF]
+		     ^ m10_checksum_hi_table[crc >> 8]);
 	}
 
 	return (crc == expected) ? 0 : -1;
 }
-
-static uint16_t
-m10_crc_step(uint16_t c, uint8_t b)
-{
-	int c0, c1, t, t6, t7, s;
-	c1 = c & 0xFF;
-	// B
-	b  = (b >> 1) | ((b & 1) << 7);
-	b ^= (b >> 2) & 0xFF;
-	// A1
-	t6 = ( c     & 1) ^ ((c >> 2) & 1) ^ ((c >> 4) & 1);
-	t7 = ((c >> 1) & 1) ^ ((c >> 3) & 1) ^ ((c >> 5) & 1);
-	t = (c & 0x3F) | (t6 << 6) | (t7 << 7);
-	// A2
-	s  = (c >> 7) & 0xFF;
-	s ^= (s >> 2) & 0xFF;
-	c0 = b ^ t ^ s;
-	return ((c1 << 8) | c0) & 0xFFFF;
-}
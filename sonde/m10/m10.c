@@ -10,16 +10,18 @@
 #include "gps/time.h"
 #include "physics.h"
 
-static void m10_parse_frame(SondeData *dst, const M10Frame *frame);
-static void m20_parse_frame(SondeData *dst, const M10Frame *frame);
-
 struct m10decoder {
 	Framer f;
 	M10Frame raw_frame[4];
 	M10Frame frame[2];
-	char serial[16];
+	uint8_t serial_raw[6];      /* Frame type + serial bytes the string was built from */
+	char serial[32];
 };
 
+static void m10_parse_frame(M10Decoder *self, SondeData *dst, const M10Frame *frame);
+static void m20_parse_frame(M10Decoder *self, SondeData *dst, const M10Frame *frame);
+static void ground_speed(SondeData *dst, float dx, float dy);
+
 #ifndef NDEBUG
 static FILE *debug;
 #endif
@@ -30,6 +32,8 @@ m10_decoder_init(int samplerate)
 	M10Decoder *d = malloc(sizeof(*d));
 
 	framer_init_gfsk(&d->f, samplerate, M10_BAUDRATE, M10_FRAME_LEN, M10_SYNCWORD, M10_SYNC_LEN);
+	memset(d->serial_raw, 0, sizeof(d->serial_raw));
+	d->serial[0] = 0;
 
 #ifndef NDEBUG
 	debug = fopen("/tmp/m10frames.data", "wb");
@@ -75,7 +79,7 @@ m10_decode(M10Decoder *self, SondeData *dst, const float *src, size_t len)
 	/* Parse based on packet type */
 	switch (self->frame[0].type) {
 	case M10_FTYPE_DATA:
-		m10_parse_frame(dst, self->frame);
+		m10_parse_frame(self, dst, self->frame);
 #ifndef NDEBUG
 	if (debug) {
 		fwrite(&self->frame[0], sizeof(self->frame[0]), 1, debug);
@@ -84,7 +88,7 @@ m10_decode(M10Decoder *self, SondeData *dst, const float *src, size_t len)
 #endif
 		break;
 	case M20_FTYPE_DATA:
-		m20_parse_frame(dst, self->frame);
+		m20_parse_frame(self, dst, self->frame);
 #ifndef NDEBUG
 	if (debug) {
 		fwrite(&self->frame[0], sizeof(self->frame[0]), 1, debug);
@@ -101,14 +105,20 @@ m10_decode(M10Decoder *self, SondeData *dst, const float *src, size_t len)
 
 /* Static functions {{{ */
 static void
-m10_parse_frame(SondeData *dst, const M10Frame *frame)
+m10_parse_frame(M10Decoder *self, SondeData *dst, const M10Frame *frame)
 {
 	float dx, dy, dz;
 	M10Frame_9f *data_frame_9f = (M10Frame_9f*)frame;
 
-	/* Parse serial number */
+	/* Parse serial number, only if it changed since the last frame */
+	if (self->serial_raw[0] != M10_FTYPE_DATA
+	 || memcmp(self->serial_raw + 1, data_frame_9f->serial, sizeof(data_frame_9f->serial))) {
+		self->serial_raw[0] = M10_FTYPE_DATA;
+		memcpy(self->serial_raw + 1, data_frame_9f->serial, sizeof(data_frame_9f->serial));
+		m10_9f_serial(self->serial, data_frame_9f);
+	}
 	dst->fields |= DATA_SERIAL;
-	m10_9f_serial(dst->serial, data_frame_9f);
+	strcpy(dst->serial, self->serial);
 
 	/* Parse GPS time */
 	dst->fields |= DATA_TIME;
@@ -126,10 +136,8 @@ m10_parse_frame(SondeData *dst, const M10Frame *frame)
 	dz = m10_9f_dalt(data_frame_9f);
 
 	dst->fields |= DATA_SPEED;
-	dst->speed = sqrtf(dx*dx + dy*dy);
 	dst->climb = dz;
-	dst->heading = atan2f(dy, dx) * 180.0 / M_PI;
-	if (dst->heading < 0) dst->heading += 360.0;
+	ground_speed(dst, dx, dy);
 
 	/* Parse PTU data */
 	dst->fields |= DATA_PTU;
@@ -140,14 +148,20 @@ m10_parse_frame(SondeData *dst, const M10Frame *frame)
 }
 
 static void
-m20_parse_frame(SondeData *dst, const M10Frame *frame)
+m20_parse_frame(M10Decoder *self, SondeData *dst, const M10Frame *frame)
 {
 	M20Frame_20 *data_frame_20 = (M20Frame_20*)frame;
 	float dx, dy, dz;
 
-	/* Parse serial number */
+	/* Parse serial number, only if it changed since the last frame */
+	if (self->serial_raw[0] != M20_FTYPE_DATA
+	 || memcmp(self->serial_raw + 1, data_frame_20->sn, sizeof(data_frame_20->sn))) {
+		self->serial_raw[0] = M20_FTYPE_DATA;
+		memcpy(self->serial_raw + 1, data_frame_20->sn, sizeof(data_frame_20->sn));
+		m20_20_serial(self->serial, data_frame_20);
+	}
 	dst->fields |= DATA_SERIAL;
-	m20_20_serial(dst->serial, data_frame_20);
+	strcpy(dst->serial, self->serial);
 
 	/* Parse sequence number */
 	dst->fields |= DATA_SEQ;
@@ -170,9 +184,7 @@ m20_parse_frame(SondeData *dst, const M10Frame *frame)
 
 	dst->fields |= DATA_SPEED;
 	dst->climb = dz;
-	dst->speed = sqrtf(dx*dx + dy*dy);
-	dst->heading = atan2f(dy, dx) * 180.0 / M_PI;
-	if (dst->heading < 0) dst->heading += 360;
+	ground_speed(dst, dx, dy);
 
 	/* Parse PTU data */
 	dst->fields |= DATA_PTU;
@@ -181,4 +193,19 @@ m20_parse_frame(SondeData *dst, const M10Frame *frame)
 	dst->rh = 0;
 	dst->pressure = altitude_to_pressure(dst->alt);
 }
+
+static void
+ground_speed(SondeData *dst, float dx, float dy)
+{
+	dst->speed = sqrtf(dx*dx + dy*dy);
+
+	/* Heading is undefined when stationary */
+	if (dst->speed == 0) {
+		dst->heading = 0;
+		return;
+	}
+
+	dst->heading = atan2f(dy, dx) * 180.0 / M_PI;
+	if (dst->heading < 0) dst->heading += 360.0;
+}
 /* }}} */
@@ -9,13 +9,16 @@
 #include "parser.h"
 #include "physics.h"
 #include "protocol.h"
+#include "sonde/calibstore.h"
 
 typedef struct {
 	MRZN1Calibration data;
 	uint16_t bitmask;
+	CalibStore store;
 } MRZN1Metadata;
 
 static void update_calibration(MRZN1Metadata *calib, int seq, uint8_t *data);
+static void sync_calibration_store(MRZN1Metadata *calib);
 static void mrzn1_parse_frame(SondeData *dst, const MRZN1Frame *frame, const MRZN1Metadata *calib);
 
 struct mrzn1decoder {
@@ -40,6 +43,7 @@ mrzn1_decoder_init(int samplerate)
 
 	d->offset = 0;
 	memset(&d->meta, 0, sizeof(d->meta));
+	calibstore_init(&d->meta.store, MRZN1_CALIB_FRAGSIZE, MRZN1_CALIB_FRAGCOUNT);
 
 #ifndef NDEBUG
 	debug = fopen("/tmp/mrzn1frames.data", "wb");
@@ -51,6 +55,7 @@ mrzn1_decoder_init(int samplerate)
 void
 mrzn1_decoder_deinit(MRZN1Decoder *d) {
 	framer_deinit(&d->f);
+	calibstore_close(&d->meta.store);
 	free(d);
 
 #ifndef NDEBUG
@@ -128,7 +133,7 @@ mrzn1_parse_frame(SondeData *dst, const MRZN1Frame *frame, const MRZN1Metadata *
 
 	log_debug_hexdump(&calib->data, sizeof(calib->data));
 
-	if (BITMASK_CHECK(calib->bitmask, 0x40 | 0x02)) {
+	if (BITMASK_CHECK(calib->bitmask, MRZN1_CALIB_SERIAL_MASK)) {
 		mrzn1_serial(dst->serial, &calib->data);
 		dst->fields |= DATA_SERIAL;
 	}
@@ -137,7 +142,50 @@ mrzn1_parse_frame(SondeData *dst, const MRZN1Frame *frame, const MRZN1Metadata *
 static void
 update_calibration(MRZN1Metadata *calib, int seq, uint8_t *data)
 {
-	memcpy(((uint8_t*)&calib->data) + MRZN1_CALIB_FRAGSIZE * seq, data, MRZN1_CALIB_FRAGSIZE);
-	calib->bitmask |= 1 << (MRZN1_CALIB_FRAGCOUNT - seq - 1);
+	uint8_t *dst;
+	uint16_t mask;
+
+	if (seq < 0 || seq >= MRZN1_CALIB_FRAGCOUNT) return;
+	dst = (uint8_t*)&calib->data + MRZN1_CALIB_FRAGSIZE * seq;
+	mask = 1 << (MRZN1_CALIB_FRAGCOUNT - seq - 1);
+
+	if (!(calib->bitmask & mask) || memcmp(dst, data, MRZN1_CALIB_FRAGSIZE)) {
+		memcpy(dst, data, MRZN1_CALIB_FRAGSIZE);
+		calib->bitmask |= mask;
+		calibstore_put(&calib->store, seq, data);
+	}
+
+	if (BITMASK_CHECK(calib->bitmask, MRZN1_CALIB_SERIAL_MASK)) {
+		sync_calibration_store(calib);
+	}
+}
+
+static void
+sync_calibration_store(MRZN1Metadata *calib)
+{
+	const int had_serial = calib->store.serial[0];
+	char serial[CALIBSTORE_SERIAL_LEN];
+	uint8_t *fragment;
+	uint16_t mask;
+	int i;
+
+	mrzn1_serial(serial, &calib->data);
+	if (calibstore_open(&calib->store, serial)) return;
+
+	/* If the serial changed, all calibration data except for the serial
+	 * number itself belongs to another sonde */
+	if (had_serial) calib->bitmask &= MRZN1_CALIB_SERIAL_MASK;
+
+	/* Save the fragments the store is missing, load the ones we are missing */
+	for (i=0; i<MRZN1_CALIB_FRAGCOUNT; i++) {
+		fragment = (uint8_t*)&calib->data + MRZN1_CALIB_FRAGSIZE * i;
+		mask = 1 << (MRZN1_CALIB_FRAGCOUNT - i - 1);
+
+		if (calib->bitmask & mask) {
+			calibstore_put(&calib->store, i, fragment);
+		} else if (!calibstore_get(&calib->store, i, fragment)) {
+			calib->bitmask |= mask;
+		}
+	}
 }
 /* }}} */
@@ -12,6 +12,7 @@
 
 #define MRZN1_CALIB_FRAGCOUNT   16
 #define MRZN1_CALIB_FRAGSIZE    4
+#define MRZN1_CALIB_SERIAL_MASK (0x40 | 0x02)
 
 PACK(typedef struct {
 	uint8_t data[MRZN1_FRAME_LEN/8];
@@ -1,3 +1,4 @@
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 #include "frame.h"
@@ -17,29 +18,66 @@ static const uint8_t _prn[RS41_PRN_PERIOD] = {
 	0x78, 0x6e, 0x3b, 0xae, 0xbf, 0x7b, 0x4c, 0xc1
 };
 
+/* Bit-reversal lookup table */
+static const uint8_t _bitrev[256] = {
+	0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0,
+	0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0,
+	0x08, 0x88, 0x48, 0xc8, 0x28, 0xa8, 0x68, 0xe8,
+	0x18, 0x98, 0x58, 0xd8, 0x38, 0xb8, 0x78, 0xf8,
+	0x04, 0x84, 0x44, 0xc4, 0x24, 0xa4, 0x64, 0xe4,
+	0x14, 0x94, 0x54, 0xd4, 0x34, 0xb4, 0x74, 0xf4,
+	0x0c, 0x8c, 0x4c, 0xcc, 0x2c, 0xac, 0x6c, 0xec,
+	0x1c, 0x9c, 0x5c, 0xdc, 0x3c, 0xbc, 0x7c, 0xfc,
+	0x02, 0x82, 0x42, 0xc2, 0x22, 0xa2, 0x62, 0xe2,
+	0x12, 0x92, 0x52, 0xd2, 0x32, 0xb2, 0x72, 0xf2,
+	0x0a, 0x8a, 0x4a, 0xca, 0x2a, 0xaa, 0x6a, 0xea,
+	0x1a, 0x9a, 0x5a, 0xda, 0x3a, 0xba, 0x7a, 0xfa,
+	0x06, 0x86, 0x46, 0xc6, 0x26, 0xa6, 0x66, 0xe6,
+	0x16, 0x96, 0x56, 0xd6, 0x36, 0xb6, 0x76, 0xf6,
+	0x0e, 0x8e, 0x4e, 0xce, 0x2e, 0xae, 0x6e, 0xee,
+	0x1e, 0x9e, 0x5e, 0xde, 0x3e, 0xbe, 0x7e, 0xfe,
+	0x01, 0x81, 0x41, 0xc1, 0x21, 0xa1, 0x61, 0xe1,
+	0x11, 0x91, 0x51, 0xd1, 0x31, 0xb1, 0x71, 0xf1,
+	0x09, 0x89, 0x49, 0xc9, 0x29, 0xa9, 0x69, 0xe9,
+	0x19, 0x99, 0x59, 0xd9, 0x39, 0xb9, 0x79, 0xf9,
+	0x05, 0x85, 0x45, 0xc5, 0x25, 0xa5, 0x65, 0xe5,
+	0x15, 0x95, 0x55, 0xd5, 0x35, 0xb5, 0x75, 0xf5,
+	0x0d, 0x8d, 0x4d, 0xcd, 0x2d, 0xad, 0x6d, 0xed,
+	0x1d, 0x9d, 0x5d, 0xdd, 0x3d, 0xbd, 0x7d, 0xfd,
+	0x03, 0x83, 0x43, 0xc3, 0x23, 0xa3, 0x63, 0xe3,
+	0x13, 0x93, 0x53, 0xd3, 0x33, 0xb3, 0x73, 0xf3,
+	0x0b, 0x8b, 0x4b, 0xcb, 0x2b, 0xab, 0x6b, 0xeb,
+	0x1b, 0x9b, 0x5b, 0xdb, 0x3b, 0xbb, 0x7b, 0xfb,
+	0x07, 0x87, 0x47, 0xc7, 0x27, 0xa7, 0x67, 0xe7,
+	0x17, 0x97, 0x57, 0xd7, 0x37, 0xb7, 0x77, 0xf7,
+	0x0f, 0x8f, 0x4f, 0xcf, 0x2f, 0xaf, 0x6f, 0xef,
+	0x1f, 0x9f, 0x5f, 0xdf, 0x3f, 0xbf, 0x7f, 0xff
+};
+
+static void descramble(RS41Frame *dst, const RS41Frame *src, size_t start, size_t end);
+
 void
 rs41_frame_descramble(RS41Frame *dst, RS41Frame *src)
 {
-	int i;
-	uint8_t *raw_src = (uint8_t*)src;
-	uint8_t *raw_dst = (uint8_t*)dst;
+	const size_t header_len = offsetof(RS41Frame, data);
+	size_t len;
 
+	/* Descramble up to the extended flag, which tells how long the frame is */
+	descramble(dst, src, 0, header_len);
 
-	/* Reorder bits in the frame and descramble */
-	for (i=0; i<RS41_MAX_FRAME_LEN; i++) {
-		uint8_t tmp = 0;
-		for (int j=0; j<8; j++) {
-			tmp |= ((raw_src[i] >> (7-j)) & 0x1) << j;
-		}
-		raw_dst[i] = tmp ^ _prn[i % LEN(_prn)];
-	}
+	len = header_len + RS41_DATA_LEN + (rs41_frame_is_extended(dst) ? RS41_XDATA_LEN : 0);
+	descramble(dst, src, header_len, len);
 }
 
 int
-rs41_frame_correct(RS41Frame *frame, RSDecoder *rs)
+rs41_frame_correct(RS41Frame *frame, RSDecoder *rs, const uint8_t *weak)
 {
+	const int data_offset = offsetof(RS41Frame, data);
+	const int checksum_offset = offsetof(RS41Frame, rs_checksum);
 	int i, block, chunk_len;
 	int errors, new_errors;
+	int erasure_count;
+	int erasures[RS41_REEDSOLOMON_N];
 	uint8_t rs_block[RS41_REEDSOLOMON_N];
 
 	if (!rs41_frame_is_extended(frame)) {
@@ -61,6 +99,27 @@ rs41_frame_correct(RS41Frame *frame, RSDecoder *rs)
 
 		/* Error correct */
 		new_errors = rs_fix_block(rs, rs_block);
+
+		/* If that failed, retry marking bytes containing low-confidence bits
+		 * as erasures */
+		if (new_errors < 0 && weak) {
+			erasure_count = 0;
+			for (i=0; i<chunk_len; i++) {
+				if (weak[data_offset + RS41_REEDSOLOMON_INTERLEAVING*i + block - 1]) {
+					erasures[erasure_count++] = i;
+				}
+			}
+			for (i=0; i<RS41_REEDSOLOMON_T; i++) {
+				if (weak[checksum_offset + i + RS41_REEDSOLOMON_T*block]) {
+					erasures[erasure_count++] = RS41_REEDSOLOMON_K + i;
+				}
+			}
+
+			if (erasure_count) {
+				new_errors = rs_fix_block_erasures(rs, rs_block, erasures, erasure_count);
+			}
+		}
+
 		if (new_errors < 0 || errors < 0) errors = -1;
 		else errors += new_errors;
 
@@ -81,3 +140,24 @@ rs41_frame_is_extended(RS41Frame *f)
 {
 	return f->extended_flag == RS41_FLAG_EXTENDED;
 }
+
+/* Static functions {{{ */
+static void
+descramble(RS41Frame *dst, const RS41Frame *src, size_t start, size_t end)
+{
+	const uint8_t *raw_src = (const uint8_t*)src;
+	uint8_t *raw_dst = (uint8_t*)dst;
+	size_t i, j, prn_idx, chunk_len;
+
+	/* Reorder bits in each byte and descramble, one PRN period at a time so
+	 * that the PRN index never wraps around within the inner loop */
+	for (i=start; i<end; i+=chunk_len) {
+		prn_idx = i % RS41_PRN_PERIOD;
+		chunk_len = MIN(RS41_PRN_PERIOD - prn_idx, end - i);
+
+		for (j=0; j<chunk_len; j++) {
+			raw_dst[i+j] = _bitrev[raw_src[i+j]] ^ _prn[prn_idx+j];
+		}
+	}
+}
+/* }}} */
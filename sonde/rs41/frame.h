@@ -6,7 +6,8 @@
 
 /**
  * Descramble the bits inside of the frame, both in terms of ordering and by
- * xor'ing with a PRN sequence
+ * xor'ing with a PRN sequence. Only the bytes that are part of the frame, as
+ * indicated by its extended flag, are descrambled
  *
  * @param src   the frame to descramble
  * @param dst   destination to write the resulting frame into
@@ -18,10 +19,13 @@ void rs41_frame_descramble(RS41Frame *dst, RS41Frame *src);
  *
  * @param frame the frame to correct
  * @param rs the Reed-Solomon decoder to use
+ * @param weak optional bitmap of low-confidence bits, parallel to the frame.
+ *        Bytes containing any such bit are treated as erasures if plain error
+ *        correction fails. Can be NULL
  * @return -1 if too many errors
  *         else number of errors corrected
  */
-int rs41_frame_correct(RS41Frame *frame, RSDecoder *rs);
+int rs41_frame_correct(RS41Frame *frame, RSDecoder *rs, const uint8_t *weak);
 
 
 /**
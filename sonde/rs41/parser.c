@@ -7,8 +7,43 @@
 #include "parser.h"
 #include "utils.h"
 
+void
+rs41_calib_cache_update(RS41CalibCache *cache, const RS41Calibration *calib)
+{
+	int i, j;
+
+	cache->t_ref_valid = calib->t_ref[0] && calib->t_ref[1];
+	cache->t_ref_base = calib->t_ref[0];
+	cache->t_ref_delta = calib->t_ref[1] - calib->t_ref[0];
+	cache->rh_ref_base = calib->rh_ref[0];
+	cache->rh_ref_delta = calib->rh_ref[1] - calib->rh_ref[0];
+
+	cache->t_resist_coeff = calib->t_calib_coeff[0];
+	cache->th_resist_coeff = calib->th_calib_coeff[0];
+	for (i=0; i<3; i++) {
+		cache->t_temp_poly[i] = calib->t_temp_poly[i];
+		cache->th_temp_poly[i] = calib->th_temp_poly[i];
+	}
+
+	/* Correction polynomials, highest degree first */
+	for (i=0; i<6; i++) {
+		cache->t_calib_poly[i] = calib->t_calib_coeff[6-i];
+		cache->th_calib_poly[i] = calib->th_calib_coeff[6-i];
+	}
+
+	cache->rh_cap_scale = 1.0f / calib->rh_cap_calib[0];
+	cache->rh_cap_gain = calib->rh_cap_calib[1];
+	for (i=0; i<7; i++) {
+		for (j=0; j<6; j++) {
+			cache->rh_calib_poly[i][j] = calib->rh_calib_coeff[6-i][5-j];
+		}
+	}
+
+	cache->valid = 1;
+}
+
 float
-rs41_temp(RS41Subframe_PTU *ptu, RS41Calibration *calib)
+rs41_temp(RS41Subframe_PTU *ptu, const RS41CalibCache *calib)
 {
 	const float adc_main = (uint32_t)ptu->temp_main[0]
 	                      | (uint32_t)ptu->temp_main[1] << 8
@@ -30,8 +65,8 @@ rs41_temp(RS41Subframe_PTU *ptu, RS41Calibration *calib)
 	adc_raw = (adc_main - adc_ref1) / (adc_ref2 - adc_ref1);
 
 	/* Compute resistance */
-	r_raw = calib->t_ref[0] + (calib->t_ref[1] - calib->t_ref[0])*adc_raw;
-	r_t = r_raw * calib->t_calib_coeff[0];
+	r_raw = calib->t_ref_base + calib->t_ref_delta*adc_raw;
+	r_t = r_raw * calib->t_resist_coeff;
 
 	/* Compute temperature based on corrected resistance */
 	t_uncal = calib->t_temp_poly[0]
@@ -39,9 +74,9 @@ rs41_temp(RS41Subframe_PTU *ptu, RS41Calibration *calib)
 	     + calib->t_temp_poly[2]*r_t*r_t;
 
 	t_cal = 0;
-	for (i=6; i>0; i--) {
+	for (i=0; i<6; i++) {
 		t_cal *= t_uncal;
-		t_cal += calib->t_calib_coeff[i];
+		t_cal += calib->t_calib_poly[i];
 	}
 	t_cal += t_uncal;
 
@@ -49,7 +84,7 @@ rs41_temp(RS41Subframe_PTU *ptu, RS41Calibration *calib)
 }
 
 float
-rs41_humidity(RS41Subframe_PTU *ptu, RS41Calibration *calib)
+rs41_humidity(RS41Subframe_PTU *ptu, const RS41CalibCache *calib, float t_temp)
 {
 	float adc_main = (uint32_t)ptu->humidity_main[0]
 	                       | (uint32_t)ptu->humidity_main[1] << 8
@@ -62,39 +97,36 @@ rs41_humidity(RS41Subframe_PTU *ptu, RS41Calibration *calib)
 	                       | (uint32_t)ptu->humidity_ref2[2] << 16;
 
 	int i, j;
-	float f1, f2;
-	float adc_raw, c_raw, c_cal, rh_uncal, rh_cal, rh_temp_uncal, rh_temp, t_temp;
+	float f2;
+	float adc_raw, c_raw, c_cal, rh_uncal, rh_cal, rh_temp_uncal, rh_temp;
 
 	if (adc_ref2 - adc_ref1 == 0) return NAN;
 
-	/* Get RH sensor temperature and actual temperature */
+	/* Get RH sensor temperature */
 	rh_temp_uncal = rs41_temp_humidity(ptu, calib);
-	t_temp = rs41_temp(ptu, calib);
 
 	/* Compute RH calibrated temperature */
 	rh_temp = 0;
-	for (i=6; i>0; i--) {
+	for (i=0; i<6; i++) {
 		rh_temp *= rh_temp_uncal;
-		rh_temp += calib->th_calib_coeff[i];
+		rh_temp += calib->th_calib_poly[i];
 	}
 	rh_temp += rh_temp_uncal;
 
 	/* Get raw capacitance of the RH sensor */
 	adc_raw = (adc_main - adc_ref1) / (adc_ref2 - adc_ref1);
-	c_raw = calib->rh_ref[0] + adc_raw * (calib->rh_ref[1] - calib->rh_ref[0]);
-	c_cal = (c_raw / calib->rh_cap_calib[0] - 1) * calib->rh_cap_calib[1];
+	c_raw = calib->rh_ref_base + adc_raw * calib->rh_ref_delta;
+	c_cal = (c_raw * calib->rh_cap_scale - 1) * calib->rh_cap_gain;
 
 	/* Derive raw RH% from capacitance and temperature response */
 	rh_uncal = 0;
 	rh_temp = (rh_temp - 20) / 180;
-	f1 = 1;
 	for (i=0; i<7; i++) {
-		f2 = 1;
+		f2 = 0;
 		for (j=0; j<6; j++) {
-			rh_uncal += f1 * f2 * calib->rh_calib_coeff[i][j];
-			f2 *= rh_temp;
+			f2 = f2 * rh_temp + calib->rh_calib_poly[i][j];
 		}
-		f1 *= c_cal;
+		rh_uncal = rh_uncal * c_cal + f2;
 	}
 
 	/* Account for different temperature between air and RH sensor */
@@ -103,7 +135,7 @@ rs41_humidity(RS41Subframe_PTU *ptu, RS41Calibration *calib)
 }
 
 float
-rs41_temp_humidity(RS41Subframe_PTU *ptu, RS41Calibration *calib)
+rs41_temp_humidity(RS41Subframe_PTU *ptu, const RS41CalibCache *calib)
 {
 	const float adc_main = (uint32_t)ptu->temp_humidity_main[0]
 	                      | (uint32_t)ptu->temp_humidity_main[1] << 8
@@ -119,14 +151,14 @@ rs41_temp_humidity(RS41Subframe_PTU *ptu, RS41Calibration *calib)
 
 	/* If no reference or no calibration data, retern */
 	if (adc_ref2 - adc_ref1 == 0) return NAN;
-	if (!calib->t_ref[0] || !calib->t_ref[1]) return NAN;
+	if (!calib->t_ref_valid) return NAN;
 
 	/* Compute ADC gain and bias */
 	adc_raw = (adc_main - adc_ref1) / (adc_ref2 - adc_ref1);
 
 	/* Compute resistance */
-	r_raw = calib->t_ref[0] + adc_raw * (calib->t_ref[1] - calib->t_ref[0]);
-	r_t = r_raw * calib->th_calib_coeff[0];
+	r_raw = calib->t_ref_base + adc_raw * calib->t_ref_delta;
+	r_t = r_raw * calib->th_resist_coeff;
 
 	/* Compute temperature based on corrected resistance */
 	t_uncal = calib->th_temp_poly[0]
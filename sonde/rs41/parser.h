@@ -3,10 +3,31 @@
 
 #include "protocol.h"
 
+/* Constants derived from the calibration data, only recomputed when it changes */
+typedef struct {
+	int valid;
+	int t_ref_valid;
+	float t_ref_base, t_ref_delta;      /* Temperature ref. resistance = base + delta * adc */
+	float rh_ref_base, rh_ref_delta;    /* RH ref. capacitance = base + delta * adc */
+	float t_resist_coeff, th_resist_coeff;
+	float t_temp_poly[3], th_temp_poly[3];
+	float t_calib_poly[6], th_calib_poly[6];    /* Highest degree first */
+	float rh_cap_scale, rh_cap_gain;
+	float rh_calib_poly[7][6];          /* Highest degree first, in both dimensions */
+} RS41CalibCache;
+
+/**
+ * Recompute the calibration-derived constants
+ *
+ * @param cache cache to update
+ * @param calib calibration data to derive the constants from
+ */
+void rs41_calib_cache_update(RS41CalibCache *cache, const RS41Calibration *calib);
+
 /* PTU subframe. Credits to @einergehtnochrein for the calibration data interpretation */
-float rs41_temp(RS41Subframe_PTU *ptu, RS41Calibration *calib);
-float rs41_humidity(RS41Subframe_PTU *ptu, RS41Calibration *calib);
-float rs41_temp_humidity(RS41Subframe_PTU *ptu, RS41Calibration *calib);
+float rs41_temp(RS41Subframe_PTU *ptu, const RS41CalibCache *calib);
+float rs41_humidity(RS41Subframe_PTU *ptu, const RS41CalibCache *calib, float temp);
+float rs41_temp_humidity(RS41Subframe_PTU *ptu, const RS41CalibCache *calib);
 float rs41_pressure(RS41Subframe_PTU *ptu, RS41Calibration *calib);
 
 /* GPS position subframe */
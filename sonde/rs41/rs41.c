@@ -11,11 +11,19 @@
 #include "log/log.h"
 #include "parser.h"
 #include "physics.h"
+#include "sonde/calibstore.h"
 #include "xdata/xdata.h"
 
+/* Number of sondes calibration data is kept for at the same time. Sondes of
+ * the same type share a decoder, so their frames can be interleaved */
+#define RS41_METADATA_SLOTS 4
+
 typedef struct {
 	RS41Calibration data;
 	uint8_t bitmask[sizeof(RS41Calibration)/8/RS41_CALIB_FRAGSIZE+1];
+	RS41CalibCache cache;
+	CalibStore store;           /* store.serial identifies the sonde */
+	unsigned long last_used;
 } RS41Metadata;
 
 
@@ -24,13 +32,43 @@ struct rs41decoder {
 	RSDecoder rs;
 	RS41Frame raw_frame[2];
 	RS41Frame frame;
-	RS41Metadata metadata;
+	RS41Metadata metadata[RS41_METADATA_SLOTS];
+	RS41Metadata *current;      /* Metadata of the sonde the last frame came from */
+	unsigned long frame_count;
 };
 
-static void rs41_parse_subframe(SondeData *dst, RS41Subframe *subframe, RS41Metadata *metadata);
+static void rs41_parse_subframe(SondeData *dst, RS41Subframe *subframe, RS41Decoder *self);
+static RS41Metadata *rs41_get_metadata(RS41Decoder *self, const char *serial);
 static void rs41_update_metadata(RS41Metadata *m, RS41Subframe_Info *s);
+static void rs41_reset_metadata(RS41Metadata *m);
+static void rs41_sync_metadata(RS41Metadata *m);
 static float rs41_get_calib_percent(RS41Metadata *m);
 static void rs41_xdata_decode(SondeData *dst, const char *asciiData, int len);
+static int xdata_hex(uint32_t *dst, const char *src, int len);
+
+#define XDATA_HEADER_LEN 4
+#define XDATA_MAX_FIELDS 5
+
+/* Fixed-width payload layout for each known XDATA instrument, in hex digits */
+typedef struct {
+	int instr_id;
+	int field_count;
+	int field_len[XDATA_MAX_FIELDS];
+	int diag_len;       /* Length of the non-measurement (ID/diagnostic) block */
+} XdataLayout;
+
+static const XdataLayout _xdata_layouts[] = {
+	/* Pump temp, O3 current, battery voltage, pump current, ext. voltage */
+	{RS41_XDATA_ENSCI_OZONE, 5, {4, 5, 2, 3, 2}, 17},
+};
+
+/* Hex digit values, plus one. 0 marks an invalid character */
+static const uint8_t _hex_nibble[256] = {
+	['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+	['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+	['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+	['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+};
 
 #ifndef NDEBUG
 static FILE *debug;
@@ -96,13 +134,21 @@ __global RS41Decoder*
 rs41_decoder_init(int samplerate)
 {
 	RS41Decoder *d = malloc(sizeof(*d));
+	int i;
+
 	framer_init_gfsk(&d->f, samplerate, RS41_BAUDRATE, RS41_FRAME_LEN, RS41_SYNCWORD, RS41_SYNC_LEN);
+	framer_track_weak_bits(&d->f);
 	rs_init(&d->rs, RS41_REEDSOLOMON_N, RS41_REEDSOLOMON_K, RS41_REEDSOLOMON_POLY,
 			RS41_REEDSOLOMON_FIRST_ROOT, RS41_REEDSOLOMON_ROOT_SKIP);
 
-	/* Initialize calibration data struct and metadata */
-	memcpy(&d->metadata.data, _default_calib_data, sizeof(d->metadata.data));
-	memset(&d->metadata.bitmask, 0x00, sizeof(d->metadata.bitmask));
+	/* Initialize calibration data structs and metadata */
+	for (i=0; i<RS41_METADATA_SLOTS; i++) {
+		rs41_reset_metadata(&d->metadata[i]);
+		calibstore_init(&d->metadata[i].store, RS41_CALIB_FRAGSIZE, RS41_CALIB_FRAGCOUNT);
+		d->metadata[i].last_used = 0;
+	}
+	d->current = &d->metadata[0];
+	d->frame_count = 0;
 
 #ifndef NDEBUG
 	debug = fopen("/tmp/rs41frames.data", "wb");
@@ -114,8 +160,13 @@ rs41_decoder_init(int samplerate)
 __global void
 rs41_decoder_deinit(RS41Decoder *d)
 {
+	int i;
+
 	framer_deinit(&d->f);
 	rs_deinit(&d->rs);
+	for (i=0; i<RS41_METADATA_SLOTS; i++) {
+		calibstore_close(&d->metadata[i].store);
+	}
 	free(d);
 #ifndef NDEBUG
 	if (debug) fclose(debug);
@@ -139,7 +190,7 @@ rs41_decode(RS41Decoder *self, SondeData *dst, const float *src, size_t len)
 
 	/* Descramble and error correct */
 	rs41_frame_descramble(&self->frame, self->raw_frame);
-	errcount = rs41_frame_correct(&self->frame, &self->rs);
+	errcount = rs41_frame_correct(&self->frame, &self->rs, self->f.weak);
 
 #ifndef NDEBUG
 	if (debug && errcount >= 0) {
@@ -153,6 +204,7 @@ rs41_decode(RS41Decoder *self, SondeData *dst, const float *src, size_t len)
 	/* Prepare to parse subframes */
 	dst->fields = 0;
 	frame_offset = 0;
+	self->frame_count++;
 
 	/* Parse expected data length from extended flag */
 	frame_data_len = RS41_DATA_LEN + (rs41_frame_is_extended(&self->frame) ? RS41_XDATA_LEN : 0);
@@ -166,7 +218,7 @@ rs41_decode(RS41Decoder *self, SondeData *dst, const float *src, size_t len)
 		/* Validate the subframe's checksum against the one received. If it
 		 * doesn't match, discard it */
 		if (crc16_ccitt_false(subframe->data, subframe->len) == *(uint16_t*)&subframe->data[subframe->len]) {
-			rs41_parse_subframe(dst, subframe, &self->metadata);
+			rs41_parse_subframe(dst, subframe, self);
 		}
 
 		/* Update pointer to the subframe */
@@ -179,15 +231,81 @@ rs41_decode(RS41Decoder *self, SondeData *dst, const float *src, size_t len)
 }
 
 /* Static functions {{{ */
+static RS41Metadata*
+rs41_get_metadata(RS41Decoder *self, const char *serial)
+{
+	RS41Metadata *m, *oldest;
+	int i;
+
+	/* Look for the slot assigned to this sonde, keeping track of the least
+	 * recently used one (empty slots have never been used) */
+	oldest = &self->metadata[0];
+	for (i=0; i<RS41_METADATA_SLOTS; i++) {
+		m = &self->metadata[i];
+		if (m->store.serial[0] && !strcmp(m->store.serial, serial)) {
+			m->last_used = self->frame_count;
+			return m;
+		}
+		if (m->last_used < oldest->last_used) oldest = m;
+	}
+
+	/* New sonde: evict the least recently used one, and start over from the
+	 * stored calibration record for this serial, if any */
+	m = oldest;
+	rs41_reset_metadata(m);
+	calibstore_open(&m->store, serial);
+	rs41_sync_metadata(m);
+	m->last_used = self->frame_count;
+
+	return m;
+}
+
 static void
 rs41_update_metadata(RS41Metadata *m, RS41Subframe_Info *s)
 {
-	size_t frag_offset;
+	const uint8_t mask = 1 << (7 - s->frag_seq%8);
+	uint8_t *fragment;
+
+	if (s->frag_seq >= RS41_CALIB_FRAGCOUNT) return;
+
+	/* Copy the fragment and update the bitmap of the fragments left. Derived
+	 * constants go stale only if a fragment is new or its contents changed */
+	fragment = (uint8_t*)&m->data + s->frag_seq * LEN(s->frag_data);
+	if (!(m->bitmask[s->frag_seq/8] & mask) || memcmp(fragment, s->frag_data, LEN(s->frag_data))) {
+		memcpy(fragment, s->frag_data, LEN(s->frag_data));
+		m->bitmask[s->frag_seq/8] |= mask;
+		m->cache.valid = 0;
+		calibstore_put(&m->store, s->frag_seq, s->frag_data);
+	}
+}
+
+static void
+rs41_reset_metadata(RS41Metadata *m)
+{
+	memcpy(&m->data, _default_calib_data, sizeof(m->data));
+	memset(&m->bitmask, 0x00, sizeof(m->bitmask));
+	m->cache.valid = 0;
+}
 
-	/* Copy the fragment and update the bitmap of the fragments left */
-	frag_offset = s->frag_seq * LEN(s->frag_data);
-	memcpy((uint8_t*)&m->data + frag_offset, s->frag_data, LEN(s->frag_data));
-	m->bitmask[s->frag_seq/8] |= (1 << (7 - s->frag_seq%8));
+static void
+rs41_sync_metadata(RS41Metadata *m)
+{
+	uint8_t *fragment;
+	uint8_t mask;
+	int i;
+
+	/* Save the fragments the store is missing, load the ones we are missing */
+	for (i=0; i<RS41_CALIB_FRAGCOUNT; i++) {
+		fragment = (uint8_t*)&m->data + i * RS41_CALIB_FRAGSIZE;
+		mask = 1 << (7 - i%8);
+
+		if (m->bitmask[i/8] & mask) {
+			calibstore_put(&m->store, i, fragment);
+		} else if (!calibstore_get(&m->store, i, fragment)) {
+			m->bitmask[i/8] |= mask;
+			m->cache.valid = 0;
+		}
+	}
 }
 
 static float
@@ -202,14 +320,16 @@ rs41_get_calib_percent(RS41Metadata *m)
 }
 
 static void
-rs41_parse_subframe(SondeData *dst, RS41Subframe *subframe, RS41Metadata *metadata)
+rs41_parse_subframe(SondeData *dst, RS41Subframe *subframe, RS41Decoder *self)
 {
 	RS41Subframe_Info *status = (RS41Subframe_Info*)subframe;
 	RS41Subframe_PTU *ptu = (RS41Subframe_PTU*)subframe;
 	RS41Subframe_GPSInfo *gpsinfo = (RS41Subframe_GPSInfo*)subframe;
 	RS41Subframe_GPSPos *gpspos = (RS41Subframe_GPSPos*)subframe;
 	RS41Subframe_XDATA *xdata = (RS41Subframe_XDATA*)subframe;
+	RS41Metadata *metadata = self->current;
 
+	char serial[RS41_SERIAL_LEN+1];
 	uint16_t burstkill_timer;
 	float x, y, z, dx, dy, dz;
 
@@ -220,6 +340,13 @@ rs41_parse_subframe(SondeData *dst, RS41Subframe *subframe, RS41Metadata *metada
 	case RS41_SFTYPE_INFO:
 		/* Frame sequence number, serial no., board info, calibration data */
 		status = (RS41Subframe_Info*)subframe;
+
+		/* Switch to the calibration data of the sonde this frame came from.
+		 * Frames without a valid info subframe are assumed to come from the
+		 * same sonde as the previous one */
+		memcpy(serial, status->serial, RS41_SERIAL_LEN);
+		serial[RS41_SERIAL_LEN] = 0;
+		metadata = self->current = rs41_get_metadata(self, serial);
 		rs41_update_metadata(metadata, status);
 
 		dst->fields |= DATA_SERIAL;
@@ -240,9 +367,13 @@ rs41_parse_subframe(SondeData *dst, RS41Subframe *subframe, RS41Metadata *metada
 		/* Temperature, humidity, pressure */
 		ptu = (RS41Subframe_PTU*)subframe;
 
+		if (!metadata->cache.valid) {
+			rs41_calib_cache_update(&metadata->cache, &metadata->data);
+		}
+
 		dst->fields |= DATA_PTU;
-		dst->temp = rs41_temp(ptu, &metadata->data);
-		dst->rh = rs41_humidity(ptu, &metadata->data);
+		dst->temp = rs41_temp(ptu, &metadata->cache);
+		dst->rh = rs41_humidity(ptu, &metadata->cache, dst->temp);
 		dst->pressure = rs41_pressure(ptu, &metadata->data);
 		dst->calib_percent = rs41_get_calib_percent(metadata);
 		break;
@@ -291,33 +422,83 @@ rs41_parse_subframe(SondeData *dst, RS41Subframe *subframe, RS41Metadata *metada
 static void
 rs41_xdata_decode(SondeData *dst, const char *asciiData, int len)
 {
-	unsigned int r_pumpTemp, r_o3Current, r_battVoltage, r_pumpCurrent, r_extVoltage;
+	const XdataLayout *layout;
+	uint32_t header, fields[XDATA_MAX_FIELDS];
+	int i, instrumentID, offset;
 	float pumpTemp, o3Current;
-	unsigned int instrumentID, instrumentNum;
 
-	while (len > 0) {
-		sscanf(asciiData, "%02X%02X", &instrumentID, &instrumentNum);
-		asciiData += 4;
-		len -= 4;
+	/* Instruments are daisy-chained: each block is a 4-digit header
+	 * (instrument ID + position in the chain) followed by a fixed-width
+	 * payload that depends on the instrument ID */
+	while (len >= XDATA_HEADER_LEN) {
+		if (xdata_hex(&header, asciiData, XDATA_HEADER_LEN)) {
+			log_debug("Malformed XDATA header, %d chars left", len);
+			return;
+		}
+		asciiData += XDATA_HEADER_LEN;
+		len -= XDATA_HEADER_LEN;
+		instrumentID = header >> 8;
+
+		for (layout = NULL, i=0; i<(int)LEN(_xdata_layouts); i++) {
+			if (_xdata_layouts[i].instr_id == instrumentID) {
+				layout = &_xdata_layouts[i];
+				break;
+			}
+		}
+
+		/* Unknown payload length, no way to find the next instrument */
+		if (!layout) {
+			log_debug("Unknown XDATA instrument ID %02x", instrumentID);
+			return;
+		}
+
+		/* Parse fields. If any of them is not valid hex, this is not a
+		 * measurement block but a diagnostic one */
+		for (i=0, offset=0; i<layout->field_count && offset + layout->field_len[i] <= len; i++) {
+			if (xdata_hex(&fields[i], asciiData + offset, layout->field_len[i])) break;
+			offset += layout->field_len[i];
+		}
+
+		if (i < layout->field_count) {
+			if (len < layout->diag_len) break;
+			asciiData += layout->diag_len;
+			len -= layout->diag_len;
+			continue;
+		}
+		asciiData += offset;
+		len -= offset;
 
 		switch (instrumentID) {
 		case RS41_XDATA_ENSCI_OZONE:
-			if (sscanf(asciiData, "%04X%05X%02X%03X%02X",
-			           &r_pumpTemp, &r_o3Current, &r_battVoltage, &r_pumpCurrent, &r_extVoltage) == 5) {
-				asciiData += 16;
-				pumpTemp = (r_pumpTemp & 0x8000 ? -1 : 1) * 0.001 * (r_pumpTemp & 0x7FFF) + 273.15;
-				o3Current = r_o3Current * 1e-5;
-
-				dst->fields |= DATA_OZONE;
-				dst->o3_mpa = xdata_ozone_mpa(o3Current, DEFAULT_O3_FLOWRATE, pumpTemp);
-			} else {
-				/* Diagnostic data */
-				asciiData += 17;
-			}
+			pumpTemp = (fields[0] & 0x8000 ? -1 : 1) * 0.001 * (fields[0] & 0x7FFF) + 273.15;
+			o3Current = fields[1] * 1e-5;
+
+			dst->fields |= DATA_OZONE;
+			dst->o3_mpa = xdata_ozone_mpa(o3Current, DEFAULT_O3_FLOWRATE, pumpTemp);
 			break;
 		default:
 			break;
 		}
 	}
+
+	if (len > 0) {
+		log_debug("Truncated XDATA block, %d chars left", len);
+	}
+}
+
+static int
+xdata_hex(uint32_t *dst, const char *src, int len)
+{
+	uint32_t value;
+	uint8_t nibble;
+
+	for (value = 0; len > 0; len--) {
+		nibble = _hex_nibble[(uint8_t)*src++];
+		if (!nibble) return 1;
+		value = value << 4 | (nibble - 1);
+	}
+
+	*dst = value;
+	return 0;
 }
 /* }}} */
@@ -0,0 +1,443 @@
+/**
+ * Build-time generator for the read-only lookup tables used by the library.
+ * Each table is declared in the header of the module using it, and the
+ * definitions for each module are written to a separate file.
+ * Invoked by CMake as: tablegen <ecc_tables.c> <physics_tables.c>
+ *
+ * Code parameters are pulled straight from the protocol headers, so the
+ * tables stay in sync with the decoders that use them.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "decode/ecc/tables.h"
+#include "physics.h"
+#include "sonde/ims100/protocol.h"
+#include "sonde/rs41/protocol.h"
+
+typedef struct {
+	const char *name;
+	int n, k;
+	unsigned gen_poly;
+	int first_root, root_skip;
+	int root_count;
+} CodeParams;
+
+static int gen_ecc_tables(const char *path);
+static int gen_physics_tables(const char *path);
+static FILE *open_output(const char *path);
+static void gen_gf_tables(FILE *fd, const CodeParams *code);
+static int gen_ims100_bch_tables(FILE *fd);
+static void gen_dfm09_hamming_table(FILE *fd);
+static int gen_m10_checksum_tables(FILE *fd);
+static uint16_t m10_crc_step(uint16_t c, uint8_t b);
+static void gf_alpha_init(uint8_t *alpha, int n, unsigned gen_poly);
+static uint16_t bch_syndrome(const uint8_t *alpha, int degree);
+static void gen_crc16_table(FILE *fd, const char *name, uint16_t poly);
+static void gen_crc16_refin_refout_table(FILE *fd, const char *name, uint16_t poly);
+static void gen_pressure_table(FILE *fd);
+static void print_u8_array(FILE *fd, const char *type, const char *name, const uint8_t *data, int len);
+static void print_u16_table(FILE *fd, const char *name, uint16_t table[CRC16_SLICES][256]);
+
+static const CodeParams _codes[] = {
+	{"rs41", RS41_REEDSOLOMON_N, RS41_REEDSOLOMON_K, RS41_REEDSOLOMON_POLY,
+	 RS41_REEDSOLOMON_FIRST_ROOT, RS41_REEDSOLOMON_ROOT_SKIP, RS41_REEDSOLOMON_T},
+};
+
+int
+main(int argc, char *argv[])
+{
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s <ecc_tables.c> <physics_tables.c>\n", argv[0]);
+		return 1;
+	}
+
+	if (gen_ecc_tables(argv[1])) return 1;
+	if (gen_physics_tables(argv[2])) return 1;
+
+	return 0;
+}
+
+/* Static functions {{{ */
+static int
+gen_ecc_tables(const char *path)
+{
+	FILE *fd;
+	size_t i;
+
+	if (!(fd = open_output(path))) return 1;
+	fprintf(fd, "#include \"decode/ecc/tables.h\"\n\n");
+
+	/* Galois field tables */
+	for (i=0; i<LEN(_codes); i++) {
+		gen_gf_tables(fd, &_codes[i]);
+	}
+
+	fprintf(fd, "const GFTables gf_tables[] = {\n");
+	for (i=0; i<LEN(_codes); i++) {
+		fprintf(fd, "\t{%d, %d, 0x%x, %d, %d, %d, %s_alpha, %s_logtable, %s_zeroes, %s_gaproots},\n",
+				_codes[i].n, _codes[i].k, _codes[i].gen_poly,
+				_codes[i].first_root, _codes[i].root_skip, _codes[i].root_count,
+				_codes[i].name, _codes[i].name, _codes[i].name, _codes[i].name);
+	}
+	fprintf(fd, "};\n");
+	fprintf(fd, "const int gf_tables_count = %d;\n\n", (int)LEN(_codes));
+
+	/* iMS100 BCH syndrome tables */
+	if (gen_ims100_bch_tables(fd)) {
+		fclose(fd);
+		return 1;
+	}
+
+	/* DFM Hamming decoding table */
+	gen_dfm09_hamming_table(fd);
+
+	/* M10 checksum tables */
+	if (gen_m10_checksum_tables(fd)) {
+		fclose(fd);
+		return 1;
+	}
+
+	/* CRC tables. CCITT-FALSE and AUG-CCITT share the same polynomial */
+	gen_crc16_table(fd, "crc16_ccitt_table", 0x1021);
+	gen_crc16_refin_refout_table(fd, "crc16_modbus_table", 0xA001);
+
+	return fclose(fd) ? 1 : 0;
+}
+
+static int
+gen_physics_tables(const char *path)
+{
+	FILE *fd;
+
+	if (!(fd = open_output(path))) return 1;
+	fprintf(fd, "#include \"physics.h\"\n\n");
+
+	/* Altitude to pressure table */
+	gen_pressure_table(fd);
+
+	return fclose(fd) ? 1 : 0;
+}
+
+static FILE*
+open_output(const char *path)
+{
+	FILE *fd;
+
+	if (!(fd = fopen(path, "w"))) {
+		fprintf(stderr, "Could not open %s for writing\n", path);
+		return NULL;
+	}
+
+	fprintf(fd, "/* Generated by tablegen, do not edit */\n");
+	return fd;
+}
+
+static void
+gen_gf_tables(FILE *fd, const CodeParams *code)
+{
+	const int n = code->n;
+	uint8_t alpha[256], logtable[256], zeroes[256], gaproots[256];
+	char name[64];
+	int i, exp;
+
+	/* alpha[i] = a^i, logtable[a^i] = i. Log of zero is undefined, and the
+	 * log of one is 0 rather than n so that it is a valid symbol index */
+	gf_alpha_init(alpha, n, code->gen_poly);
+	logtable[0] = 0;
+	for (i=0; i<n; i++) {
+		logtable[alpha[i]] = i;
+	}
+
+	/* Roots are consecutive powers of a^root_skip */
+	for (i=0; i<code->root_count; i++) {
+		exp = ((i + code->first_root) * code->root_skip) % n;
+		zeroes[i] = alpha[exp];
+	}
+	for (i=0; i<n+1; i++) {
+		exp = i ? (logtable[i] * code->root_skip) % n : 0;
+		gaproots[i ? alpha[exp] : 0] = i;
+	}
+
+	snprintf(name, sizeof(name), "%s_alpha", code->name);
+	print_u8_array(fd, "static const uint8_t", name, alpha, n+1);
+	snprintf(name, sizeof(name), "%s_logtable", code->name);
+	print_u8_array(fd, "static const uint8_t", name, logtable, n+1);
+	snprintf(name, sizeof(name), "%s_zeroes", code->name);
+	print_u8_array(fd, "static const uint8_t", name, zeroes, code->root_count);
+	snprintf(name, sizeof(name), "%s_gaproots", code->name);
+	print_u8_array(fd, "static const uint8_t", name, gaproots, n+1);
+}
+
+static int
+gen_ims100_bch_tables(FILE *fd)
+{
+	const int n = IMS100_REEDSOLOMON_N;
+	const int msg_len = IMS100_MESSAGE_LEN;
+	uint8_t alpha[256];
+	uint16_t syndrome_table[IMS100_BCH_SYNDROME_BYTES][256];
+	uint16_t error_table[1 << 12];
+	uint16_t contrib[IMS100_MESSAGE_LEN];
+	uint16_t syndrome;
+	int i, j, byte, bit;
+
+	gf_alpha_init(alpha, n, IMS100_REEDSOLOMON_POLY);
+
+	/* Bit b of the packed message is the coefficient of x^(n-1-b): compute the
+	 * syndrome contribution of each bit */
+	for (i=0; i<msg_len; i++) {
+		contrib[i] = bch_syndrome(alpha, n - 1 - i);
+	}
+
+	/* Syndrome of each byte of the packed message, for each byte position */
+	for (byte=0; byte<IMS100_BCH_SYNDROME_BYTES; byte++) {
+		for (i=0; i<256; i++) {
+			syndrome = 0;
+			for (bit=0; bit<8; bit++) {
+				if (i & (1 << bit) && 8*byte + bit < msg_len) {
+					syndrome ^= contrib[8*byte + bit];
+				}
+			}
+			syndrome_table[byte][i] = syndrome;
+		}
+	}
+
+	/* Syndrome to error pattern, for all single and double bit errors */
+	memset(error_table, 0, sizeof(error_table));
+	for (i=0; i<msg_len; i++) {
+		error_table[contrib[i]] = 1 << 12 | i;
+		for (j=0; j<i; j++) {
+			syndrome = contrib[i] ^ contrib[j];
+			if (error_table[syndrome]) {
+				fprintf(stderr, "BCH syndrome collision at %d,%d\n", i, j);
+				return 1;
+			}
+			error_table[syndrome] = 2 << 12 | i << 6 | j;
+		}
+	}
+
+	fprintf(fd, "const uint16_t ims100_bch_syndrome_table[IMS100_BCH_SYNDROME_BYTES][256] = {\n");
+	for (byte=0; byte<IMS100_BCH_SYNDROME_BYTES; byte++) {
+		fprintf(fd, "\t{");
+		for (i=0; i<256; i++) {
+			fprintf(fd, "%s0x%04x,", i % 8 ? " " : "\n\t\t", syndrome_table[byte][i]);
+		}
+		fprintf(fd, "\n\t},\n");
+	}
+	fprintf(fd, "};\n\n");
+
+	fprintf(fd, "const uint16_t ims100_bch_error_table[1 << 12] = {");
+	for (i=0; i<(int)LEN(error_table); i++) {
+		fprintf(fd, "%s0x%04x,", i % 8 ? " " : "\n\t", error_table[i]);
+	}
+	fprintf(fd, "\n};\n\n");
+
+	return 0;
+}
+
+static void
+gen_dfm09_hamming_table(FILE *fd)
+{
+	const uint8_t hamming_bitmasks[] = {0xaa, 0x66, 0x1e, 0xff};
+	uint8_t table[256];
+	uint8_t data;
+	int errpos;
+	int i, j, ones;
+
+	for (i=0; i<256; i++) {
+		/* Each bit of errpos is the parity of the byte under a mask */
+		errpos = 0;
+		for (j=0; j<(int)sizeof(hamming_bitmasks); j++) {
+			for (ones=0, data=i & hamming_bitmasks[j]; data; ones++) {
+				data &= data-1;
+			}
+			errpos |= (ones % 2) << j;
+		}
+
+		if (errpos > 7) {
+			table[i] = HAMMING_UNCORRECTABLE;
+		} else if (errpos) {
+			table[i] = ((i ^ (1 << (8 - errpos))) & 0xF0) | HAMMING_CORRECTED;
+		} else {
+			table[i] = i & 0xF0;
+		}
+	}
+
+	print_u8_array(fd, "const uint8_t", "dfm09_hamming_table", table, LEN(table));
+}
+
+static int
+gen_m10_checksum_tables(FILE *fd)
+{
+	uint8_t data_table[256], lo_table[256], hi_table[256];
+	uint16_t expected, actual;
+	int i, c, b;
+
+	/* The checksum step is linear in both the state and the input byte, so
+	 * the contributions of each can be tabulated separately */
+	for (i=0; i<256; i++) {
+		data_table[i] = m10_crc_step(0, i);
+		lo_table[i] = m10_crc_step(i, 0);
+		hi_table[i] = m10_crc_step(i << 8, 0);
+	}
+
+	/* Exhaustively check the tables against the reference implementation */
+	for (c=0; c<0x10000; c++) {
+		for (b=0; b<256; b++) {
+			expected = m10_crc_step(c, b);
+			actual = (c & 0xFF) << 8 | (data_table[b] ^ lo_table[c & 0xFF] ^ hi_table[c >> 8]);
+			if (expected != actual) {
+				fprintf(stderr, "M10 checksum mismatch: state %04x, byte %02x\n", c, b);
+				return 1;
+			}
+		}
+	}
+
+	print_u8_array(fd, "const uint8_t", "m10_checksum_data_table", data_table, LEN(data_table));
+	print_u8_array(fd, "const uint8_t", "m10_checksum_lo_table", lo_table, LEN(lo_table));
+	print_u8_array(fd, "const uint8_t", "m10_checksum_hi_table", hi_table, LEN(hi_table));
+
+	return 0;
+}
+
+/**
+ * Reference bit-by-bit implementation of the M10 checksum step
+ */
+static uint16_t
+m10_crc_step(uint16_t c, uint8_t b)
+{
+	int c0, c1, t, t6, t7, s;
+	c1 = c & 0xFF;
+	// B
+	b  = (b >> 1) | ((b & 1) << 7);
+	b ^= (b >> 2) & 0xFF;
+	// A1
+	t6 = ( c     & 1) ^ ((c >> 2) & 1) ^ ((c >> 4) & 1);
+	t7 = ((c >> 1) & 1) ^ ((c >> 3) & 1) ^ ((c >> 5) & 1);
+	t = (c & 0x3F) | (t6 << 6) | (t7 << 7);
+	// A2
+	s  = (c >> 7) & 0xFF;
+	s ^= (s >> 2) & 0xFF;
+	c0 = b ^ t ^ s;
+	return ((c1 << 8) | c0) & 0xFFFF;
+}
+
+static void
+gf_alpha_init(uint8_t *alpha, int n, unsigned gen_poly)
+{
+	unsigned tmp;
+	int i;
+
+	alpha[0] = 1;
+	for (i=1; i<n+1; i++) {
+		tmp = (unsigned)alpha[i-1] << 1;
+		tmp = (tmp >= (unsigned)n+1 ? tmp ^ gen_poly : tmp);
+		alpha[i] = tmp;
+	}
+}
+
+/**
+ * Syndromes of x^degree in a narrow-sense binary BCH code correcting two
+ * errors: S1 = a^degree in the low 6 bits, S3 = a^(3*degree) in the high 6.
+ * S2 and S4 are redundant in a binary code: S2 = S1^2, and S4 = S2^2.
+ */
+static uint16_t
+bch_syndrome(const uint8_t *alpha, int degree)
+{
+	const int n = IMS100_REEDSOLOMON_N;
+
+	return alpha[degree % n] | alpha[(3 * degree) % n] << 6;
+}
+
+static void
+gen_crc16_table(FILE *fd, const char *name, uint16_t poly)
+{
+	uint16_t table[CRC16_SLICES][256];
+	uint16_t crc;
+	int i, j;
+
+	/* First slice: CRC of a single byte, bit by bit */
+	for (i=0; i<256; i++) {
+		crc = i << 8;
+		for (j=0; j<8; j++) {
+			crc = crc & 0x8000 ? (crc << 1) ^ poly : (crc << 1);
+		}
+		table[0][i] = crc;
+	}
+
+	/* Other slices: same as the previous one, followed by a zero byte */
+	for (j=1; j<CRC16_SLICES; j++) {
+		for (i=0; i<256; i++) {
+			crc = table[j-1][i];
+			table[j][i] = (crc << 8) ^ table[0][crc >> 8];
+		}
+	}
+
+	print_u16_table(fd, name, table);
+}
+
+static void
+gen_crc16_refin_refout_table(FILE *fd, const char *name, uint16_t poly)
+{
+	uint16_t table[CRC16_SLICES][256];
+	uint16_t crc;
+	int i, j;
+
+	for (i=0; i<256; i++) {
+		crc = i;
+		for (j=0; j<8; j++) {
+			crc = crc & 0x0001 ? (crc >> 1) ^ poly : (crc >> 1);
+		}
+		table[0][i] = crc;
+	}
+
+	for (j=1; j<CRC16_SLICES; j++) {
+		for (i=0; i<256; i++) {
+			crc = table[j-1][i];
+			table[j][i] = (crc >> 8) ^ table[0][crc & 0xFF];
+		}
+	}
+
+	print_u16_table(fd, name, table);
+}
+
+static void
+gen_pressure_table(FILE *fd)
+{
+	int i;
+
+	fprintf(fd, "const float altitude_pressure_table[%d] = {", PRESSURE_TABLE_LEN);
+	for (i=0; i<PRESSURE_TABLE_LEN; i++) {
+		fprintf(fd, "%s%.8ef,", i % 8 ? " " : "\n\t", altitude_to_pressure_exact(i * PRESSURE_TABLE_STEP));
+	}
+	fprintf(fd, "\n};\n\n");
+}
+
+static void
+print_u8_array(FILE *fd, const char *type, const char *name, const uint8_t *data, int len)
+{
+	int i;
+
+	fprintf(fd, "%s %s[%d] = {", type, name, len);
+	for (i=0; i<len; i++) {
+		fprintf(fd, "%s0x%02x,", i % 16 ? " " : "\n\t", data[i]);
+	}
+	fprintf(fd, "\n};\n");
+}
+
+static void
+print_u16_table(FILE *fd, const char *name, uint16_t table[CRC16_SLICES][256])
+{
+	int i, j;
+
+	fprintf(fd, "const uint16_t %s[CRC16_SLICES][256] = {\n", name);
+	for (j=0; j<CRC16_SLICES; j++) {
+		fprintf(fd, "\t{");
+		for (i=0; i<256; i++) {
+			fprintf(fd, "%s0x%04x,", i % 8 ? " " : "\n\t\t", table[j][i]);
+		}
+		fprintf(fd, "\n\t},\n");
+	}
+	fprintf(fd, "};\n\n");
+}
+/* }}} */
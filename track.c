@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <string.h>
+#include "track.h"
+
+#define CHUNK_START(k) (TRACK_CHUNK_BASE * ((1 << (k)) - 1))
+#define CHUNK_LEN(k)   (TRACK_CHUNK_BASE << (k))
+
+static int chunk_index(int idx);
+
+void
+track_init(Track *t)
+{
+	memset(t->points, 0, sizeof(t->points));
+	t->count = 0;
+}
+
+void
+track_deinit(Track *t)
+{
+	int i;
+
+	for (i=0; i<TRACK_MAX_CHUNKS; i++) {
+		free(t->points[i]);
+	}
+	track_init(t);
+}
+
+void
+track_clear(Track *t)
+{
+	t->count = 0;
+}
+
+int
+track_push(Track *t, const GeoPoint *point)
+{
+	int chunk;
+
+	chunk = chunk_index(t->count);
+	if (chunk >= TRACK_MAX_CHUNKS) return 1;
+	if (!t->points[chunk] && !(t->points[chunk] = malloc(CHUNK_LEN(chunk) * sizeof(GeoPoint)))) return 1;
+
+	t->points[chunk][t->count - CHUNK_START(chunk)] = *point;
+	t->count++;
+	return 0;
+}
+
+int
+track_count(const Track *t)
+{
+	return t->count;
+}
+
+const GeoPoint*
+track_get(const Track *t, int idx)
+{
+	int chunk;
+
+	if (idx < 0 || idx >= t->count) return NULL;
+
+	chunk = chunk_index(idx);
+	return &t->points[chunk][idx - CHUNK_START(chunk)];
+}
+
+/* Static functions {{{ */
+static int
+chunk_index(int idx)
+{
+	unsigned int q = idx / TRACK_CHUNK_BASE + 1;
+	int k;
+
+	/* Chunk k starts at BASE * (2^k - 1), so k = floor(log2(idx/BASE + 1)) */
+	for (k=0; q > 1; k++) q >>= 1;
+	return k;
+}
+/* }}} */
@@ -0,0 +1,79 @@
+#ifndef track_h
+#define track_h
+
+#include <time.h>
+
+/**
+ * Append-only storage for the points of a sonde track. Points are stored in
+ * chunks of geometrically increasing size (TRACK_CHUNK_BASE << k points for
+ * chunk k), so a fixed-size chunk table is enough for any flight, and a chunk
+ * is never moved once allocated: pointers handed out by the read API stay
+ * valid until the track is cleared or freed.
+ */
+
+#define TRACK_CHUNK_BASE 256
+#define TRACK_MAX_CHUNKS 20
+
+typedef struct {
+	unsigned int id;
+	time_t utc_time;
+	float lat, lon, alt;
+	float spd, hdg, climb;
+	float pressure;
+	float temp, rh, dewpt;
+} GeoPoint;
+
+typedef struct {
+	GeoPoint *points[TRACK_MAX_CHUNKS];
+	int count;
+} Track;
+
+/**
+ * Initialize an empty track
+ *
+ * @param t track to initialize
+ */
+void track_init(Track *t);
+
+/**
+ * Free all the chunks allocated by a track
+ *
+ * @param t track to free
+ */
+void track_deinit(Track *t);
+
+/**
+ * Remove all points from a track. Chunks are kept allocated for reuse
+ *
+ * @param t track to clear
+ */
+void track_clear(Track *t);
+
+/**
+ * Append a point to the track. Not thread-safe: the track must only be read
+ * from the thread appending to it
+ *
+ * @param t track to append to
+ * @param point point to append
+ * @return 0 on success, 1 if memory could not be allocated
+ */
+int track_push(Track *t, const GeoPoint *point);
+
+/**
+ * Get the number of points in a track
+ *
+ * @param t track
+ * @return number of points
+ */
+int track_count(const Track *t);
+
+/**
+ * Get a point from the track
+ *
+ * @param t track to read from
+ * @param idx point index, 0 <= idx < track_count()
+ * @return pointer to the point, NULL if out of range
+ */
+const GeoPoint* track_get(const Track *t, int idx);
+
+#endif
@@ -19,6 +19,7 @@
 #define INFO_COUNT (PTU_INFO_COUNT + GPS_INFO_COUNT + SONDE_INFO_COUNT + XDATA_INFO_COUNT)
 
 extern char *_decoder_names[];
+extern const char *_decoder_argvs[];
 extern int _decoder_count;
 
 static void init_windows(int update_interval);
@@ -26,13 +27,14 @@ static void redraw(void);
 static void draw_tabs(WINDOW *win, int selected);
 static void handle_resize(void);
 static void *main_loop(void *args);
+static int next_decoder(int decoder, int step);
 
 static int _running;
 static pthread_t _tid;
 static struct {
 	WINDOW *win;
 	WINDOW *tabs;
-	int last_slot;
+	int last_generation;
 	int receiver_location_set;
 	float lat, lon, alt;
 	enum { ABSOLUTE=0, RELATIVE, POS_TYPE_COUNT } pos_type;
@@ -56,7 +58,7 @@ tui_init(int update_interval)
 
 	tui.pos_type = ABSOLUTE;
 	tui.receiver_location_set = 0;
-	tui.last_slot = -1;
+	tui.last_generation = -1;
 
 	init_windows(update_interval);
 	keypad(tui.win, 1);
@@ -88,6 +90,7 @@ tui_set_ground_location(float lat, float lon, float alt)
 static void*
 main_loop(void *args)
 {
+	int generation;
 	(void)args;
 
 	while (_running) {
@@ -97,32 +100,33 @@ main_loop(void *args)
 			break;
 		case KEY_LEFT:
 		case '<':
-			set_active_decoder(get_active_decoder() - 1);
-			tui.last_slot = -1;
+			set_active_decoder(next_decoder(get_active_decoder(), -1));
+			tui.last_generation = -1;
 			break;
 		case KEY_RIGHT:
 		case '>':
-			set_active_decoder(get_active_decoder() + 1);
-			tui.last_slot = -1;
+			set_active_decoder(next_decoder(get_active_decoder(), 1));
+			tui.last_generation = -1;
 			break;
 		case '\t':
 			if (tui.receiver_location_set) {
 				tui.pos_type = (tui.pos_type + 1) % POS_TYPE_COUNT;
-				tui.last_slot = -1;
+				tui.last_generation = -1;
 			}
 			break;
 		case KEY_BTAB:
 			if (tui.receiver_location_set) {
 				tui.pos_type = (tui.pos_type - 1 + POS_TYPE_COUNT) % POS_TYPE_COUNT;
-				tui.last_slot = -1;
+				tui.last_generation = -1;
 			}
 			break;
 		default:
 			break;
 		}
 
-		if (tui.last_slot != get_slot()) {
-			tui.last_slot = get_slot();
+		generation = get_snapshot()->generation;
+		if (tui.last_generation != generation) {
+			tui.last_generation = generation;
 			redraw();
 			mvwprintw(tui.win, 1, 1, "*");
 		} else {
@@ -137,7 +141,7 @@ static void
 handle_resize(void)
 {
 	const int width = 55;
-	const int height = INFO_COUNT + 3 + 3;
+	const int height = INFO_COUNT + 3 + 3 + 1;
 	int rows, cols;
 	werase(stdscr);
 	endwin();
@@ -165,16 +169,19 @@ redraw(void)
 {
 	int rows, cols;
 	int start_row, start_col;
+	int i, left;
 	char time[64], shutdown_timer[32];
+	struct tm tm;
 	float az, el, slant;
-	const SondeData *data = get_data();
+	const DecoderSnapshot *snapshot = get_snapshot();
+	const SondeData *data = &snapshot->data;
 
 	/* Draw tabs at top of the TUI */
 	draw_tabs(tui.tabs, get_active_decoder());
 
 	/* Format data to be printable */
 	if (data->fields & DATA_TIME) {
-		strftime(time, LEN(time), "%a %b %d %Y %H:%M:%S", gmtime(&data->time));
+		strftime(time, LEN(time), "%a %b %d %Y %H:%M:%S", my_gmtime_r(&data->time, &tm));
 	} else {
 		time[0] = 0;
 	}
@@ -254,11 +261,30 @@ redraw(void)
 
 	start_row++;
 	if (data->fields & DATA_OZONE) {
-		mvwprintw(tui.win, start_row++, start_col - sizeof("Aux. data:"),
+		mvwprintw(tui.win, start_row, start_col - sizeof("Aux. data:"),
 				"Aux. data: O3=%.2f mPa", data->o3_mpa);
 	}
 	start_row++;
 
+	/* List the decoders autodetection is still trying, by their short name.
+	 * Whatever does not fit before the border is summarized as "+N" */
+	if (snapshot->active == AUTO) {
+		mvwprintw(tui.win, start_row, start_col - sizeof("Trying:"), "Trying:");
+		wmove(tui.win, start_row++, start_col);
+		for (i=AUTO+1, left=0; i<END; i++) {
+			if (snapshot->running & (1 << i)) left++;
+		}
+		for (i=AUTO+1; i<END; i++) {
+			if (!(snapshot->running & (1 << i))) continue;
+			if (getcurx(tui.win) + (int)strlen(_decoder_argvs[i]) + (left > 1 ? 4 : 0) > cols - 1) {
+				wprintw(tui.win, "+%d", left);
+				break;
+			}
+			wprintw(tui.win, "%s ", _decoder_argvs[i]);
+			left--;
+		}
+	}
+
 	wrefresh(tui.win);
 }
 
@@ -278,7 +304,7 @@ draw_tabs(WINDOW *win, int selected)
 	mvwprintw(win, 1, cols - 3, ">");
 
 	for (i=-1; i<2; i++) {
-		elem_idx = (selected + i + _decoder_count) % _decoder_count;
+		elem_idx = i ? next_decoder(selected, i) : selected;
 		if (i == 0) wattron(win, A_STANDOUT);
 		mvwprintw(win, 1, cols/2.0 + i * cols/4.0 - roundf(strlen(_decoder_names[elem_idx]) / 2.0), "%s", _decoder_names[elem_idx]);
 		if (i == 0) wattroff(win, A_STANDOUT);
@@ -287,6 +313,17 @@ draw_tabs(WINDOW *win, int selected)
 	wrefresh(win);
 }
 
+static int
+next_decoder(int decoder, int step)
+{
+	/* Skip decoders that were not compiled in */
+	do {
+		decoder = (decoder + step + _decoder_count) % _decoder_count;
+	} while (!decoder_is_available(decoder));
+
+	return decoder;
+}
+
 static void
 init_windows(int update_interval)
 {
@@ -4,10 +4,6 @@
 #include "utils.h"
 
 static float spline_tangent(const float *xs, const float *ys, int k);
-static float hermite_00(float x);
-static float hermite_01(float x);
-static float hermite_10(float x);
-static float hermite_11(float x);
 
 static unsigned int count_days(unsigned int year, unsigned int month, unsigned int day);
 
@@ -38,30 +34,89 @@ my_timegm(const struct tm *tm)
 	return time;
 }
 
-float
-cspline(const float *xs, const float *ys, float count, float x)
+struct tm*
+my_gmtime_r(const time_t *time, struct tm *tm)
+{
+#ifdef _WIN32
+	return gmtime_s(tm, time) ? NULL : tm;
+#else
+	return gmtime_r(time, tm);
+#endif
+}
+
+void
+cspline_init(CSpline *s, const float *xs, const float *ys, int count)
 {
+	float h, dy, m_i, m_next_i;
 	int i;
-	float m_i, m_next_i, t, y;
 
-	for (i=1; i<count-1; i++) {
-		if ((x - xs[i+1]) * (x - xs[i]) <= 0) {
-			/* Compute tangents at xs[i] and xs[i+1] */
-			m_i = spline_tangent(xs, ys, i);
-			m_next_i = spline_tangent(xs, ys, i+1);
+	s->count = MIN(count, CSPLINE_MAX_KNOTS);
+	s->increasing = s->count > 1 && xs[1] > xs[0];
+	s->monotonic = 1;
 
-			/* Compute spline transform between xs[i] and xs[i+1] */
-			t = (x - xs[i]) / (xs[i+1] - xs[i]);
+	for (i=0; i<s->count; i++) {
+		s->xs[i] = xs[i];
+		if (i > 0 && (s->increasing ? !(xs[i] > xs[i-1]) : !(xs[i] < xs[i-1]))) {
+			s->monotonic = 0;
+		}
+	}
 
-			y = hermite_00(t) * ys[i]
-			  + hermite_10(t) * (xs[i+1] - xs[i]) * m_i
-			  + hermite_01(t) * ys[i+1]
-			  + hermite_11(t) * (xs[i+1] - xs[i]) * m_next_i;
+	/* Expand the Hermite basis for each interval, using the tangents at
+	 * xs[i] and xs[i+1] */
+	for (i=0; i<s->count-1; i++) {
+		h = xs[i+1] - xs[i];
+		dy = ys[i+1] - ys[i];
+		m_i = h * spline_tangent(xs, ys, i);
+		m_next_i = i+1 < s->count-1
+		         ? h * spline_tangent(xs, ys, i+1)
+		         : dy;  /* Last knot: one-sided difference, h * dy/h */
+
+		s->coeffs[i][0] = ys[i];
+		s->coeffs[i][1] = m_i;
+		s->coeffs[i][2] = 3 * dy - 2 * m_i - m_next_i;
+		s->coeffs[i][3] = -2 * dy + m_i + m_next_i;
+	}
+}
 
-			return y;
+float
+cspline_eval(const CSpline *s, float x)
+{
+	const float *c;
+	int i, lo, hi;
+	float t;
+
+	/* The first interval is never used */
+	lo = 1;
+	hi = s->count - 2;
+	if (hi < lo) return -1;
+
+	if (s->monotonic) {
+		/* Binary search for the interval containing x */
+		if (s->increasing ? !(x >= s->xs[lo] && x <= s->xs[hi+1])
+		                  : !(x <= s->xs[lo] && x >= s->xs[hi+1])) {
+			return -1;
+		}
+		while (lo < hi) {
+			i = (lo + hi) / 2;
+			if (s->increasing ? x <= s->xs[i+1] : x >= s->xs[i+1]) {
+				hi = i;
+			} else {
+				lo = i + 1;
+			}
+		}
+		i = lo;
+	} else {
+		/* Knots out of order, look for the first interval containing x */
+		for (i=lo; i<=hi; i++) {
+			if ((x - s->xs[i+1]) * (x - s->xs[i]) <= 0) break;
 		}
+		if (i > hi) return -1;
 	}
-	return -1;
+
+	c = s->coeffs[i];
+	t = (x - s->xs[i]) / (s->xs[i+1] - s->xs[i]);
+
+	return c[0] + t * (c[1] + t * (c[2] + t * c[3]));
 }
 
 /* Static functions {{{ */
@@ -101,9 +156,4 @@ spline_tangent(const float *xs, const float *ys, int k)
 	return 0.5 * ((ys[k+1] - ys[k]) / (xs[k+1] - xs[k])
 	            + (ys[k] - ys[k-1]) / (xs[k] - xs[k-1]));
 }
-
-static float hermite_00(float x) { return (1 + 2*x) * (1-x)*(1-x); }
-static float hermite_10(float x) { return x * (1-x) * (1-x); }
-static float hermite_01(float x) { return x * x * (3 - 2*x); }
-static float hermite_11(float x) { return x * x * (x - 1); }
 /* }}} */
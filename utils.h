@@ -71,16 +71,43 @@ char *my_strdup(const char *str);
 time_t my_timegm(const struct tm *tm);
 
 /**
- * Given a set of ordered coordinate pairs and a point, compute the value
- * of the cubic Hermite spline joining the given pairs at that point
+ * gmtime_r, but portable since it's not part of the C standard. Unlike
+ * gmtime, safe to call from multiple threads at once
  *
+ * @param time UTC time to decompose
+ * @param tm struct to write the decomposed time to
+ * @return tm on success, NULL on failure
+ */
+struct tm *my_gmtime_r(const time_t *time, struct tm *tm);
+
+#define CSPLINE_MAX_KNOTS 12
+
+/* Cubic Hermite spline, with the polynomial for each interval precomputed */
+typedef struct {
+	int count;
+	int increasing, monotonic;
+	float xs[CSPLINE_MAX_KNOTS];
+	float coeffs[CSPLINE_MAX_KNOTS-1][4];   /* y = c0 + c1*t + c2*t^2 + c3*t^3, t in [0,1] */
+} CSpline;
+
+/**
+ * Build the cubic Hermite spline joining the given coordinate pairs
+ *
+ * @param s spline to initialize
  * @param xs x coordinates of the known points
  * @param ys y coordinates of the known points
- * @param count number of coordinates supplied
+ * @param count number of coordinates supplied, at most CSPLINE_MAX_KNOTS
+ */
+void cspline_init(CSpline *s, const float *xs, const float *ys, int count);
+
+/**
+ * Compute the value of a cubic Hermite spline at the given point
+ *
+ * @param s spline to evaluate
  * @param x input to the cubic spline
- * @return output of the spline
+ * @return output of the spline, or -1 if x is outside of the spline domain
  */
-float cspline(const float *xs, const float *ys, float count, float x);
+float cspline_eval(const CSpline *s, float x);
 
 #endif
 